@@ -1,8 +1,8 @@
 #version 330 core
 
 // input data : sent from main program
-layout (location = 0) in vec3 vertexPosition;
-layout (location = 1) in vec3 vertexColor;
+layout (location = 0) in vec2 vertexPosition;
+layout (location = 1) in vec4 vertexColor;
 
 uniform mat4 MVP;
 
@@ -11,11 +11,11 @@ out vec3 fragColor;
 
 void main ()
 {
-    vec4 v = vec4(vertexPosition, 1); // Transform an homogeneous 4D vector
+    vec4 v = vec4(vertexPosition, 0, 1); // Transform an homogeneous 4D vector, the game is flat
 
     // The color of each vertex will be interpolated
     // to produce the color of each fragment
-    fragColor = vertexColor;
+    fragColor = vertexColor.rgb;
 
     // Output position of the vertex, in clip space : MVP * position
     gl_Position = MVP * v;
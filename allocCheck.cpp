@@ -0,0 +1,64 @@
+#include "allocCheck.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#ifdef ALLOC_CHECK
+
+static std::atomic<long> newCalls(0), mallocCalls(0);
+
+bool allocCheckEnabled() { return true; }
+long allocNewCount() { return newCalls.load(); }
+long allocMallocCount() { return mallocCalls.load(); }
+
+#ifdef __GLIBC__
+/* Interpose the C allocator, glibc keeps the real one under __libc_* */
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void*, size_t);
+
+void *malloc(size_t size)
+{
+	mallocCalls.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	mallocCalls.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+	mallocCalls.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+}
+#endif
+
+static void *countedNew(size_t size)
+{
+	newCalls.fetch_add(1, std::memory_order_relaxed);
+	void *p = malloc(size ? size : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new(size_t size) { return countedNew(size); }
+void *operator new[](size_t size) { return countedNew(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+#else
+
+bool allocCheckEnabled() { return false; }
+long allocNewCount() { return 0; }
+long allocMallocCount() { return 0; }
+
+#endif
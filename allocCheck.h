@@ -0,0 +1,14 @@
+#ifndef ALLOC_CHECK_H
+#define ALLOC_CHECK_H
+
+/* Heap allocation counters for checking that frames allocate nothing once warmed up.
+ * They only count in builds made with ALLOC_CHECK defined (make ALLOC_CHECK=1),
+ * otherwise allocCheckEnabled() is false and the counts stay at zero. */
+
+bool allocCheckEnabled();
+/* operator new / new[] calls so far, on every thread */
+long allocNewCount();
+/* malloc, calloc and realloc calls so far, this includes operator new and the GL driver */
+long allocMallocCount();
+
+#endif
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/* Packs the glyphs of a HUD font source (hudFont.txt) into a one-row atlas and
+ * prints it as a C++ header, so the game has the texture without any font code.
+ * usage: atlasgen hudFont.txt > hudAtlas.h */
+
+const int glyphW = 5, glyphH = 7, pad = 1;
+
+int main (int argc, char** argv)
+{
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s <font source>\n", argv[0]);
+		return 1;
+	}
+	FILE *in = fopen(argv[1], "r");
+	if(!in) {
+		fprintf(stderr, "can't open %s\n", argv[1]);
+		return 1;
+	}
+
+	std::vector<char> chars(1, ' ');
+	std::vector<std::string> rows(glyphH*1, std::string(glyphW, '.'));
+	char line[256];
+	int row = glyphH;
+	while(fgets(line, sizeof(line), in)) {
+		line[strcspn(line, "\r\n")] = 0;
+		if(row < glyphH) {
+			if((int)strlen(line) != glyphW) {
+				fprintf(stderr, "glyph '%c' row %d is not %d wide\n", chars.back(), row, glyphW);
+				return 1;
+			}
+			rows.push_back(line);
+			row++;
+		}
+		else if(strncmp(line, "glyph ", 6) == 0 && line[6]) {
+			chars.push_back(line[6]);
+			row = 0;
+		}
+	}
+	fclose(in);
+	if(row < glyphH) {
+		fprintf(stderr, "glyph '%c' is cut short\n", chars.back());
+		return 1;
+	}
+
+	int count = chars.size();
+	int width = count*(glyphW + pad);
+	printf("/* Generated by atlasgen from the HUD font source, don't edit */\n");
+	printf("#ifndef HUD_ATLAS_H\n#define HUD_ATLAS_H\n\n");
+	printf("const int hudGlyphW = %d, hudGlyphH = %d;\n", glyphW, glyphH);
+	printf("const int hudGlyphCount = %d;\n", count);
+	printf("const int hudAtlasW = %d, hudAtlasH = %d;\n\n", width, glyphH);
+
+	// glyph index for every ASCII character, 0 is the blank space
+	int index[128] = {0};
+	for(int g=0;g<count;g++) {
+		index[(unsigned char)chars[g] & 127] = g;
+		// lower case borrows the capitals unless the font has its own
+		if(chars[g] >= 'A' && chars[g] <= 'Z' && index[chars[g] - 'A' + 'a'] == 0)
+			index[chars[g] - 'A' + 'a'] = g;
+	}
+	printf("const unsigned char hudGlyphIndex[128] = {");
+	for(int c=0;c<128;c++)
+		printf("%s%d%s", c%16 ? "" : "\n\t", index[c], c == 127 ? "" : ",");
+	printf("\n};\n\n");
+
+	// one byte per texel, top row first, glyph g starts at column g*(hudGlyphW+1)
+	printf("const unsigned char hudAtlasPixels[%d] = {", width*glyphH);
+	for(int y=0;y<glyphH;y++) {
+		printf("\n\t");
+		for(int x=0;x<width;x++) {
+			int g = x/(glyphW + pad), gx = x%(glyphW + pad);
+			int lit = gx < glyphW && rows[g*glyphH + y][gx] == '#';
+			printf("%d%s", lit ? 255 : 0, y == glyphH-1 && x == width-1 ? "" : ",");
+		}
+	}
+	printf("\n};\n\n#endif\n");
+	return 0;
+}
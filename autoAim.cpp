@@ -0,0 +1,89 @@
+#include "autoAim.h"
+#include "wallClock.h"
+
+int aimTicks(const AimSnapshot &snap, float shift, float angle)
+{
+	float move = std::abs(shift - snap.cannonShift)/(cannonSpeed*stepScale);
+	float turn = std::abs(angle - snap.cannonAngle)/(cannonTurn*stepScale);
+	float wait = (1 - snap.charge)/simStep;
+	float ticks = move > turn ? move : turn;
+	if(wait > ticks)
+		ticks = wait;
+	return (int)ceilf(ticks);
+}
+
+/* Value of shooting from (shift, angle) once the cannon gets there */
+static float evaluate(const AimSnapshot &snap, float shift, float angle, int ticks)
+{
+	float drop = fallStep(snap.fallRate)*ticks;
+	int hitBrick = -1;
+	auto scanBricks = [&](float xstart, float ystart, float slope, int xinc, float *finalx, float *finaly) {
+		int found = 0;
+		for(int i=0;i<snap.numBricks;i++)
+		{
+			float x1 = snap.brickx[i];
+			float y1 = snap.bricky[i] - drop;
+			if(y1 <= landY)
+				continue;
+			if(brickOnRay(x1,y1,xstart,ystart,slope) && updatable(x1,*finalx,xstart,xinc))
+			{
+				*finalx = x1;
+				*finaly = slope*(x1-xstart) + ystart ;
+				hitBrick = i;
+				found = 1;
+			}
+		}
+		return found;
+	};
+	auto noSegment = [](float, float, float, float) {};
+	if(!traceLaser(shift,angle,snap.mirrorx,snap.mirrory,snap.mirrorAng,snap.numMirrors,scanBricks,noSegment,snap.grid))
+		return 0;
+	return shotPoints(snap.brickColour[hitBrick]);
+}
+
+AimResult AutoAim::solve(const AimSnapshot &snap, int candidates, uint32_t seed)
+{
+	double start = wallClock();
+	const int grain = 256;
+	best.resize((candidates + grain - 1)/grain);
+	pool.parallelFor(candidates, grain, [&](int begin, int end) {
+		Chunk &mine = best[begin/grain];
+		mine.value = 0; mine.ticks = 0;
+		mine.cannonShift = snap.cannonShift; mine.cannonAngle = snap.cannonAngle;
+		uint32_t r = seed ^ ((uint32_t)begin*2654435761u);
+		if(r == 0)
+			r = 1;
+		for(int c=begin;c<end;c++)
+		{
+			// xorshift32, cheap enough to not show up next to the trace
+			r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+			float shift = snap.cannonMin + (r & 0xffff)*((snap.cannonMax - snap.cannonMin)/65535.0f);
+			float angle = snapAngle(-90.0f + (r >> 16)*(180.0f/65535.0f));
+			// the current position competes too, it needs no travel
+			if(c == 0) {
+				shift = snap.cannonShift;
+				angle = snap.cannonAngle;
+			}
+			int ticks = aimTicks(snap, shift, angle);
+			float value = evaluate(snap, shift, angle, ticks);
+			if(value > mine.value || (value == mine.value && value > 0 && ticks < mine.ticks))
+			{
+				mine.value = value; mine.ticks = ticks;
+				mine.cannonShift = shift; mine.cannonAngle = angle;
+			}
+		}
+	});
+
+	AimResult res;
+	res.cannonShift = snap.cannonShift; res.cannonAngle = snap.cannonAngle;
+	res.value = 0; res.ticks = 0;
+	for(size_t i=0;i<best.size();i++)
+		if(best[i].value > res.value || (best[i].value == res.value && res.value > 0 && best[i].ticks < res.ticks))
+		{
+			res.cannonShift = best[i].cannonShift; res.cannonAngle = best[i].cannonAngle;
+			res.value = best[i].value; res.ticks = best[i].ticks;
+		}
+	res.evaluations = candidates;
+	res.seconds = wallClock() - start;
+	return res;
+}
@@ -0,0 +1,57 @@
+#ifndef AUTO_AIM_H
+#define AUTO_AIM_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "gameLogic.h"
+#include "threadPool.h"
+
+/* Monte Carlo search for the best (cannonShift, cannonAngle) shot, used by the bot player */
+
+const int aimMaxBricks = 128;
+
+/* Read-only copy of everything a shot depends on, taken once per solve */
+struct AimSnapshot {
+	float cannonShift, cannonAngle;
+	float cannonMin, cannonMax;   // the rail, shots are only sampled on it
+	float charge;      // 1 when the laser is ready
+	float fallRate;
+	/* mirrors are only referenced, they don't move while a solve runs */
+	const float *mirrorx, *mirrory, *mirrorAng;
+	int numMirrors;
+	const MirrorGrid *grid;   // NULL to test every mirror
+	int numBricks;
+	float brickx[aimMaxBricks], bricky[aimMaxBricks];
+	int brickColour[aimMaxBricks];
+};
+
+struct AimResult {
+	float cannonShift, cannonAngle;
+	float value;       // points of the brick the shot destroys, 0 if none worth hitting
+	int ticks;         // steps until the cannon is in place and charged
+	long evaluations;
+	double seconds;
+};
+
+class AutoAim {
+public:
+	explicit AutoAim(ThreadPool &pool) : pool(pool) {}
+
+	/* Trace candidates random shots against the predicted brick positions */
+	AimResult solve(const AimSnapshot &snap, int candidates, uint32_t seed);
+
+private:
+	struct Chunk {
+		float cannonShift, cannonAngle, value;
+		int ticks;
+	};
+
+	ThreadPool &pool;
+	std::vector<Chunk> best;    // one per chunk of candidates, kept between solves
+};
+
+/* Steps the cannon needs to move from the snapshot position to (shift, angle) and recharge */
+int aimTicks(const AimSnapshot &snap, float shift, float angle);
+
+#endif
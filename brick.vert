@@ -0,0 +1,23 @@
+#version 330 core
+
+// one instance per brick : x, its height before anything fell, and colour, -1 once shot
+layout (location = 0) in float x;
+layout (location = 1) in float base;
+layout (location = 2) in int colour;
+
+uniform mat4 VP;
+uniform float fallen;     // how far every brick has fallen, the same for all of them
+
+out vec3 fragColor;
+
+void main ()
+{
+	// corners of the brick's 0.2 square, around x and its fallen height
+	vec2 corner = (vec2(gl_VertexID & 1, gl_VertexID >> 1)*2.0 - 1.0)*0.1;
+	// a shot brick stays in the buffer until it reaches the front, it collapses to nothing
+	if(colour < 0)
+		corner = vec2(0);
+	fragColor = vec3(1 - colour, colour, 0);
+
+	gl_Position = VP * vec4(x + corner.x, base - fallen + corner.y, 0, 1);
+}
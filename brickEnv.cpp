@@ -0,0 +1,229 @@
+#include "brickEnv.h"
+
+#include <string.h>
+
+#include "gameLogic.h"
+
+const float startFallRate = 0.03f;
+const double beamTime = 0.05;         // about the three frames the game shows a shot for
+
+BrickEnvBatch::BrickEnvBatch(int numEnvs, int numThreads, uint32_t seed, int ticksPerStep, int maxTicks)
+	: numEnvs(numEnvs), ticksPerStep(ticksPerStep), maxTicks(maxTicks), seed(seed), pool(numThreads),
+	cannonShift(numEnvs), cannonAngle(numEnvs), redShift(numEnvs), greenShift(numEnvs),
+	fallRate(numEnvs), mirrorx(numEnvs*numMirrors), mirrory(numEnvs*numMirrors), mirrorAng(numEnvs*numMirrors),
+	simTime(numEnvs), spawnTime(numEnvs), lastShoot(numEnvs), score(numEnvs), ticks(numEnvs), over(numEnvs), rng(numEnvs),
+	brickCount(numEnvs), brickx(numEnvs*envMaxBricks), bricky(numEnvs*envMaxBricks), brickColour(numEnvs*envMaxBricks),
+	laserSegments(numEnvs), laser(numEnvs*maxLaserSegments*4), observations(numEnvs*envObsSize), rewards(numEnvs), dones(numEnvs)
+{
+	for(int e=0;e<numEnvs;e++) {
+		// spread the seeds so neighbouring environments don't correlate
+		uint32_t s = seed*2654435761u + (uint32_t)e*40503u + 1;
+		rng[e] = s ? s : 1;
+	}
+}
+
+/* xorshift32, one stream per environment so results don't depend on the thread count */
+int BrickEnvBatch::envRand(int e)
+{
+	uint32_t x = rng[e];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	rng[e] = x;
+	return (int)(x >> 1);
+}
+
+void BrickEnvBatch::resetEnv(int e)
+{
+	cannonShift[e] = 0; cannonAngle[e] = 0;
+	redShift[e] = -1; greenShift[e] = 1;
+	fallRate[e] = startFallRate;
+	for(int i=0;i<numMirrors;i++) {
+		mirrorx[e*numMirrors+i] = mirrorStartX[i];
+		mirrory[e*numMirrors+i] = mirrorStartY[i];
+		mirrorAng[e*numMirrors+i] = envRand(e)%89+1;
+	}
+	simTime[e] = 0; spawnTime[e] = 0;
+	lastShoot[e] = -1;
+	score[e] = 0; ticks[e] = 0; over[e] = 0;
+	brickCount[e] = 0;
+	laserSegments[e] = 0;
+}
+
+EnvStepResult BrickEnvBatch::reset_all()
+{
+	pool.parallelFor(numEnvs, 256, [this](int begin, int end) {
+		for(int e=begin;e<end;e++) {
+			resetEnv(e);
+			rewards[e] = 0;
+			dones[e] = 0;
+			writeObservation(e);
+		}
+	});
+	return result();
+}
+
+EnvStepResult BrickEnvBatch::step_batch(const EnvAction *actions)
+{
+	pool.parallelFor(numEnvs, 256, [this, actions](int begin, int end) {
+		for(int e=begin;e<end;e++)
+			stepEnv(e, actions[e]);
+	});
+	return result();
+}
+
+EnvStepResult BrickEnvBatch::result() const
+{
+	EnvStepResult res;
+	res.observations = &observations[0];
+	res.rewards = &rewards[0];
+	res.dones = &dones[0];
+	return res;
+}
+
+EnvView BrickEnvBatch::view(int e) const
+{
+	EnvView v;
+	v.cannonShift = cannonShift[e]; v.cannonAngle = cannonAngle[e];
+	v.redShift = redShift[e]; v.greenShift = greenShift[e];
+	v.fallRate = fallRate[e];
+	v.charge = simTime[e] - lastShoot[e] >= 1 ? 1 : (float)(simTime[e] - lastShoot[e]);
+	v.mirrorx = &mirrorx[e*numMirrors]; v.mirrory = &mirrory[e*numMirrors]; v.mirrorAng = &mirrorAng[e*numMirrors];
+	v.numBricks = brickCount[e];
+	v.brickx = &brickx[e*envMaxBricks]; v.bricky = &bricky[e*envMaxBricks]; v.brickColour = &brickColour[e*envMaxBricks];
+	v.score = score[e];
+	v.laserSegments = simTime[e] - lastShoot[e] < beamTime ? laserSegments[e] : 0;
+	v.laser = &laser[e*maxLaserSegments*4];
+	return v;
+}
+
+void BrickEnvBatch::stepEnv(int e, const EnvAction &action)
+{
+	int before = score[e];
+	int done = 0;
+	for(int t=0;t<ticksPerStep && !done;t++) {
+		EnvAction a = action;
+		// only the first tick of a step may fire
+		if(t > 0)
+			a.shoot = 0;
+		tickEnv(e, a);
+		done = over[e] || ticks[e] >= maxTicks;
+	}
+	rewards[e] = (float)(score[e] - before);
+	dones[e] = done;
+	// auto-reset, the observation is the first one of the next episode
+	if(done)
+		resetEnv(e);
+	writeObservation(e);
+}
+
+void BrickEnvBatch::removeBrick(int e, int i)
+{
+	int base = e*envMaxBricks;
+	int n = --brickCount[e];
+	// shift down to keep spawn order, only a handful of bricks are ever alive
+	for(int j=i;j<n;j++) {
+		brickx[base+j] = brickx[base+j+1];
+		bricky[base+j] = bricky[base+j+1];
+		brickColour[base+j] = brickColour[base+j+1];
+	}
+}
+
+/* One simStep of makeChanges, the fall, bucket checks and spawning */
+void BrickEnvBatch::tickEnv(int e, const EnvAction &a)
+{
+	cannonShift[e] = checkRange(cannonShift[e] + a.cannonShift*cannonSpeed*stepScale, envCannonMin, envCannonMax);
+	cannonAngle[e] = snapAngle(checkRange(cannonAngle[e] + a.cannonRot*cannonTurn*stepScale, -90, 90));
+	redShift[e] = checkRange(redShift[e] + a.red*bucketSpeed*stepScale, -4, 4);
+	greenShift[e] = checkRange(greenShift[e] + a.green*bucketSpeed*stepScale, -4, 4);
+
+	if(a.shoot && simTime[e] - lastShoot[e] >= 1)
+		shoot(e);
+
+	int base = e*envMaxBricks;
+	float drop = fallStep(fallRate[e]);
+	for(int i=0;i<brickCount[e];i++)
+		bricky[base+i] -= drop;
+
+	// spawn order is landing order, so landed bricks are a prefix
+	while(brickCount[e] > 0 && bricky[base] <= landY) {
+		float x = brickx[base];
+		int colour = brickColour[base];
+		if(colour > 1) {
+			if(inBucket(x, redShift[e]) + inBucket(x, greenShift[e]) > 0)
+				over[e] = 1;
+		}
+		else if(inBucket(x, colour == 0 ? redShift[e] : greenShift[e]))
+			score[e] += 1000*fallRate[e];
+		removeBrick(e, 0);
+		if(over[e])
+			return;
+	}
+
+	simTime[e] += simStep;
+	ticks[e]++;
+	if(simTime[e] - spawnTime[e] >= spawnInterval(fallRate[e]) && brickCount[e] < envMaxBricks) {
+		int i = base + brickCount[e]++;
+		brickColour[i] = envRand(e)%2;
+		brickx[i] = spawnX(envRand(e));
+		bricky[i] = spawnY;
+		spawnTime[e] = simTime[e];
+	}
+}
+
+void BrickEnvBatch::shoot(int e)
+{
+	int base = e*envMaxBricks;
+	int removeindex = -1;
+	auto scanBricks = [&](float xstart, float ystart, float slope, int xinc, float *finalx, float *finaly) {
+		int found = 0;
+		for(int i=0;i<brickCount[e];i++) {
+			float x1 = brickx[base+i], y1 = bricky[base+i];
+			if(brickOnRay(x1,y1,xstart,ystart,slope) && updatable(x1,*finalx,xstart,xinc)) {
+				*finalx = x1;
+				*finaly = slope*(x1-xstart) + ystart;
+				removeindex = i;
+				found = 1;
+			}
+		}
+		return found;
+	};
+	float *beam = &laser[e*maxLaserSegments*4];
+	laserSegments[e] = 0;
+	auto addSegment = [&](float x1, float y1, float x2, float y2) {
+		float *seg = beam + 4*laserSegments[e]++;
+		seg[0] = x1; seg[1] = y1; seg[2] = x2; seg[3] = y2;
+	};
+	if(traceLaser(cannonShift[e], cannonAngle[e], &mirrorx[e*numMirrors], &mirrory[e*numMirrors], &mirrorAng[e*numMirrors], numMirrors, scanBricks, addSegment)) {
+		score[e] += shotPoints(brickColour[base+removeindex])*100*fallRate[e];
+		removeBrick(e, removeindex);
+	}
+	lastShoot[e] = simTime[e];
+}
+
+void BrickEnvBatch::writeObservation(int e)
+{
+	float *obs = &observations[e*envObsSize];
+	obs[0] = cannonShift[e];
+	obs[1] = cannonAngle[e]/90;
+	obs[2] = redShift[e];
+	obs[3] = greenShift[e];
+	obs[4] = simTime[e] - lastShoot[e] >= 1 ? 1 : (float)(simTime[e] - lastShoot[e]);
+	obs[5] = fallRate[e];
+	obs += 6;
+	for(int i=0;i<numMirrors;i++) {
+		obs[3*i] = mirrorx[e*numMirrors+i];
+		obs[3*i+1] = mirrory[e*numMirrors+i];
+		obs[3*i+2] = mirrorAng[e*numMirrors+i]/90;
+	}
+	obs += 3*numMirrors;
+	// x, y, colour, present for the lowest bricks
+	memset(obs, 0, 4*envObsBricks*sizeof(float));
+	int base = e*envMaxBricks;
+	for(int i=0;i<brickCount[e] && i<envObsBricks;i++) {
+		obs[4*i] = brickx[base+i];
+		obs[4*i+1] = bricky[base+i];
+		obs[4*i+2] = brickColour[base+i];
+		obs[4*i+3] = 1;
+	}
+}
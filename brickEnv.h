@@ -0,0 +1,93 @@
+#ifndef BRICK_ENV_H
+#define BRICK_ENV_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "threadPool.h"
+
+/* Headless batch of independent games for bot training.
+ * All state is kept as one array per field across environments (SoA),
+ * bricks of environment e live in slots [e*envMaxBricks, (e+1)*envMaxBricks). */
+
+/* One action per environment, mirrors the keyboard controls */
+struct EnvAction {
+	signed char cannonShift;  // +1 (S), -1 (F) or 0
+	signed char cannonRot;    // +1 (A), -1 (D) or 0
+	signed char red;          // red bucket, alt + arrows
+	signed char green;        // green bucket, ctrl + arrows
+	unsigned char shoot;      // space, ignored while the laser recharges
+};
+
+const int envMaxBricks = 64;
+const float envCannonMin = -3.4f, envCannonMax = 4;   // the classic cannon rail
+const int envObsBricks = 16;
+/* cannonShift, cannonAngle, 2 buckets, charge, fallRate, 3 mirrors and the lowest bricks */
+const int envObsSize = 6 + 3*3 + 4*envObsBricks;
+
+struct EnvStepResult {
+	const float *observations;    // envObsSize floats per environment
+	const float *rewards;         // score gained during the step
+	const unsigned char *dones;   // environment finished and was reset
+};
+
+/* Read-only state of one environment, for drawing it and for bots that plan on it */
+struct EnvView {
+	float cannonShift, cannonAngle, redShift, greenShift;
+	float fallRate, charge;
+	const float *mirrorx, *mirrory, *mirrorAng;   // numMirrors each
+	int numBricks;
+	const float *brickx, *bricky;                 // lowest first
+	const int *brickColour;
+	int score;
+	int laserSegments;                            // beam of the last shot while it's shown, 0 after
+	const float *laser;                           // x1, y1, x2, y2 per segment
+};
+
+class BrickEnvBatch {
+public:
+	/* ticksPerStep simulation steps run per step_batch, episodes end after maxTicks */
+	BrickEnvBatch(int numEnvs, int numThreads = 0, uint32_t seed = 1, int ticksPerStep = 4, int maxTicks = 240*120);
+
+	EnvStepResult reset_all();
+	EnvStepResult step_batch(const EnvAction *actions);
+
+	EnvView view(int e) const;
+
+	int size() const { return numEnvs; }
+	int threads() const { return pool.size(); }
+
+private:
+	void resetEnv(int e);
+	void stepEnv(int e, const EnvAction &action);
+	void tickEnv(int e, const EnvAction &action);
+	void shoot(int e);
+	void removeBrick(int e, int i);
+	void writeObservation(int e);
+	int envRand(int e);
+	EnvStepResult result() const;
+
+	int numEnvs, ticksPerStep, maxTicks;
+	uint32_t seed;
+	ThreadPool pool;
+
+	std::vector<float> cannonShift, cannonAngle, redShift, greenShift;
+	std::vector<float> fallRate, mirrorx, mirrory, mirrorAng;
+	std::vector<double> simTime, spawnTime, lastShoot;
+	std::vector<int> score, ticks;
+	std::vector<unsigned char> over;   // black brick landed in a bucket
+	std::vector<uint32_t> rng;
+
+	// bricks, kept in spawn order so the lowest ones come first
+	std::vector<int> brickCount;
+	std::vector<float> brickx, bricky;
+	std::vector<int> brickColour;
+
+	std::vector<int> laserSegments;
+	std::vector<float> laser;          // maxLaserSegments*4 per environment
+
+	std::vector<float> observations, rewards;
+	std::vector<unsigned char> dones;
+};
+
+#endif
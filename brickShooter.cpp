@@ -4,7 +4,12 @@
 #include <vector>
 #include<time.h>
 #include<stdlib.h>
-#include<set>
+#include <random>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -14,19 +19,46 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "gameLogic.h"
+#include "autoAim.h"
+#include "jobSystem.h"
+#include "frameArena.h"
+#include "allocCheck.h"
+#include "hudAtlas.h"
+#include "particles.h"
+#include "headless.h"
+#include "capture.h"
+#include "snapshot.h"
+#include "inputQueue.h"
+#include "latencyProbe.h"
+#include "framePacer.h"
+#include "tournament.h"
+#include "level.h"
+#include "trace.h"
+#include "glResources.h"
+#include "picking.h"
+#include "wallClock.h"
+
 using namespace std;
 
 struct VAO {
-	GLuint VertexArrayID;
-	GLuint VertexBuffer;
-	GLuint ColorBuffer;
+	GLVertexArray VertexArrayID;
+	GLBuffer VertexBuffer;
 
 	GLenum PrimitiveMode;
 	GLenum FillMode;
 	int NumVertices;
+	int NumIndices;          // 0 draws the vertices in order, quads use the shared index buffer
 };
 typedef struct VAO VAO;
 
+/* A vertex as the GPU gets it, position and colour interleaved in 12 bytes. The game
+ * is flat so there is no z, and every colour it draws fits RGBA8 exactly. */
+struct Vertex {
+	GLfloat x, y;
+	GLubyte rgba[4];
+};
+
 struct GLMatrices {
 	glm::mat4 projection;
 	glm::mat4 model;
@@ -34,14 +66,21 @@ struct GLMatrices {
 	GLuint MatrixID;
 } Matrices;
 
-GLuint programID;
+GLProgram programID;
+
+/* Every VAO lives here, the scene has a fixed set of objects */
+const int maxVAOs = 64;
+VAO vaoPool[maxVAOs]; int vaoCount = 0;
+
+/* Scratch memory that only lasts until the next frame starts */
+FrameArena frameArena;
 
 /* Function to load Shaders - Use it as it is */
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
+GLProgram LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+	// Create the shaders, they are deleted on return, the program keeps what it needs
+	GLShader VertexShaderID = GLShader::create(GL_VERTEX_SHADER);
+	GLShader FragmentShaderID = GLShader::create(GL_FRAGMENT_SHADER);
 
 	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
@@ -95,7 +134,7 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 
 	// Link the program
 	fprintf(stdout, "Linking program\n");
-	GLuint ProgramID = glCreateProgram();
+	GLProgram ProgramID = GLProgram::create();
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
 	glLinkProgram(ProgramID);
@@ -107,112 +146,145 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 	fprintf(stdout, "%s\n", &ProgramErrorMessage[0]);
 
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
-
 	return ProgramID;
 }
 
-static void error_callback(int error, const char* description)
+static void error_callback(int, const char* description)
 {
 	fprintf(stderr, "Error: %s\n", description);
 }
 
 void quit(GLFWwindow *window)
 {
+	glResourcesDetach();
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	//    exit(EXIT_SUCCESS);
 }
 
 
-/* Generate VAO, VBOs and return VAO handle */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
+/* Two triangles over four corners, shared by every quad's VAO */
+GLBuffer quadIndices;
+const GLubyte quadIndexData[] = { 0,1,2, 2,3,0 };
+
+/* Generate VAO, VBO and return VAO handle. With numIndices the vertices are drawn through quadIndices */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const Vertex* vertices, GLenum fill_mode=GL_FILL, int numIndices=0)
 {
-	struct VAO* vao = new struct VAO;
+	if(vaoCount == maxVAOs) {
+		fprintf(stderr, "Out of VAOs\n");
+		exit(EXIT_FAILURE);
+	}
+	struct VAO* vao = &vaoPool[vaoCount++];
 	vao->PrimitiveMode = primitive_mode;
 	vao->NumVertices = numVertices;
+	vao->NumIndices = numIndices;
 	vao->FillMode = fill_mode;
 
 	// Create Vertex Array Object
 	// Should be done after CreateWindow and before any other GL calls
-	glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
-	glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
-	glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
+	vao->VertexArrayID = GLVertexArray::create(); // VAO
+	vao->VertexBuffer = GLBuffer::create(); // VBO - vertices
 
 	glBindVertexArray (vao->VertexArrayID); // Bind the VAO
 	glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
-	glVertexAttribPointer(
-			0,                  // attribute 0. Vertices
-			3,                  // size (x,y,z)
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-			);
-
-	glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
-	glVertexAttribPointer(
-			1,                  // attribute 1. Color
-			3,                  // size (r,g,b)
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-			);
+	glBufferUpload (GL_ARRAY_BUFFER, numVertices*sizeof(Vertex), vertices, GL_STATIC_DRAW); // Copy the vertices into VBO
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));        // x,y
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, rgba));  // r,g,b,a
 
+	if(numIndices) {
+		if(!quadIndices) {
+			quadIndices = GLBuffer::create();
+			glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, quadIndices);
+			glBufferUpload (GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndexData), quadIndexData, GL_STATIC_DRAW);
+		}
+		// the element buffer binding is part of the VAO
+		glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, quadIndices);
+	}
 	return vao;
 }
 
-/* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
+/* Four corners in the order of quadIndices */
+struct VAO* createQuad (const Vertex* corners, GLenum fill_mode=GL_FILL)
+{
+	return create3DObject(GL_TRIANGLES, 4, corners, fill_mode, sizeof(quadIndexData));
+}
+
+/* Vertices of one colour from x,y pairs */
+void colourVertices (Vertex* vertices, int numVertices, const GLfloat* xy, GLfloat red, GLfloat green, GLfloat blue)
 {
-	GLfloat* color_buffer_data = new GLfloat [3*numVertices];
 	for (int i=0; i<numVertices; i++) {
-		color_buffer_data [3*i] = red;
-		color_buffer_data [3*i + 1] = green;
-		color_buffer_data [3*i + 2] = blue;
+		vertices[i].x = xy[2*i];
+		vertices[i].y = xy[2*i + 1];
+		vertices[i].rgba[0] = (GLubyte)lroundf(red*255);
+		vertices[i].rgba[1] = (GLubyte)lroundf(green*255);
+		vertices[i].rgba[2] = (GLubyte)lroundf(blue*255);
+		vertices[i].rgba[3] = 255;
 	}
+}
 
-	return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
+/* Replace the vertices of an existing VAO, for objects that change shape */
+void updateVertices (struct VAO* vao, const Vertex* vertices)
+{
+	glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer);
+	glBufferUpdate (GL_ARRAY_BUFFER, 0, vao->NumVertices*sizeof(Vertex), vertices);
 }
 
-/* Render the VBOs handled by VAO */
+/* Render the VBO handled by VAO */
 void draw3DObject (struct VAO* vao)
 {
 	// Change the Fill Mode for this object
 	glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
 
-	// Bind the VAO to use
+	// Bind the VAO to use, it holds the attribute layout and the index buffer
 	glBindVertexArray (vao->VertexArrayID);
 
-	// Enable Vertex Attribute 0 - 3d Vertices
-	glEnableVertexAttribArray(0);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
-
-	// Enable Vertex Attribute 1 - Color
-	glEnableVertexAttribArray(1);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
-
 	// Draw the geometry !
-	glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
+	if(vao->NumIndices)
+		glDrawElements(vao->PrimitiveMode, vao->NumIndices, GL_UNSIGNED_BYTE, (void*)0);
+	else
+		glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
 }
 
-VAO *rectangle[100]  ;
 VAO *cannon ;
 VAO *bucket[2];
-VAO *line[5] ; int nlines ; float mirrorx[5]; float mirrory[5];
-VAO *mirror[5];
+VAO *line[5] ; int nlines ;
 VAO *battery; VAO *nose; VAO *charge ;
-float mirrorAng[5];
-set<pair<pair<float,float> ,int> > rect;
-int BlColour[100];
+/* Mirrors come from the level, all of them are drawn from one VAO */
+vector<float> mirrorx, mirrory, mirrorAng;
+VAO *mirrorLines;
+/* Bricks in landing order, lowest first. All bricks fall at the same rate, so this is
+ * spawn order and bricks only ever leave from the front. [brickHead, size) are alive,
+ * a brick shot by the laser stays in place with colour deadBrick until it reaches the front.
+ * Nothing moves a brick as it falls: it keeps its base, its height before anything fell,
+ * and is at brickBase[i] - fallenAt(t). The front is always the next brick to land, so
+ * the arrays are the landing queue and a tick only looks at its front. */
+vector<float> brickx, brickBase; vector<int> brickColour;
+int brickHead = 0;
+const int brickTrim = 1024;           // landBricks() keeps at least this many landed bricks before dropping them
+/* How far every brick has fallen since the bases' origin, a line in simulation time
+ * through (fallAt, fallFrom) that setFallRate() rebases whenever the rate changes */
+double fallAt = 0, fallFrom = 0;
+const double rebaseDistance = 256;    // bases are moved back to 0 once they fall this far, to keep float precision
+/* What drawBricks() has to upload: every brick when the arrays were rebuilt or rebased,
+ * otherwise the bricks shot or dragged since the last frame, besides the new ones */
+int bricksDirty = 1;
+vector<int> brickChanged;
+const int deadBrick = -1;
 
 float BucShift[2];
+/* --level <file.lvlb> replaces the classic layout, see level.h. The file stays mapped,
+ * the mirror grid and the fall schedule are used straight from it. */
+const char *levelPath = NULL;
+const LevelHeader *level = NULL;
+MirrorGrid mirrorGrid;
+vector<uint32_t> gridStart, gridMirrors;    // the grid once a drag has rebuilt it, the file's until then
+int mirrorMoved = -1;                        // a dragged mirror whose vertices draw() updates
+float cannonMin = -3.4, cannonMax = 4;
+float bucketMin[2] = {-4,-4}, bucketMax[2] = {4,4};
+float spawnMin = -3, spawnMax = 4; uint32_t colourWeight[2] = {1,1};
+int nextFall = 0;
 int redStatus = 0; int greenStatus = 0;
 float cannonShift=0; int cannonShiftStatus = 0 ;
 float cannonAngle=0; int cannonRotStatus = 0 ;
@@ -226,6 +298,165 @@ int gameon = 1;
 
 int blackhits = 0, wronghits = 0, collected[2]={0,0} ;
 
+double simTime = 0; double newRec_time = 0; int count_rectangles = 0;
+double tickTime = 0;      // clock time the tick being simulated starts at
+double frameClock = 0;    // clock time at the start of this frame
+float lastDrop = 0;
+
+double fallenAt(double t)
+{
+	return fallFrom + fallStep(fallRate)*(t - fallAt)/simStep;
+}
+
+/* Bricks fall at the new rate from the start of this tick */
+void setFallRate(float rate)
+{
+	fallFrom = fallenAt(simTime);
+	fallAt = simTime;
+	fallRate = rate;
+}
+
+inline float brickY(int i, double fallen)
+{
+	return (float)(brickBase[i] - fallen);
+}
+/* Spawns draw from their own generator so a save state can carry it */
+uint32_t spawnRng = 1;
+
+/* Per-frame stages run on the job system, see main() */
+JobSystem *jobs;
+const int brickGrain = 4096;         // bricks per parallel-for chunk
+int jobStats = 0; double jobReport = 0;
+
+/* Stress mode, --stress <bricks per wave> drops whole waves of bricks to find what breaks first */
+int stressMode = 0;
+int stressBricks = 100000;
+string stressPattern = "uniform";
+double stressEvery = 2;              // seconds of simulation between waves
+double stressWave = -1e9;
+std::mt19937 stressRng(1);
+/* kept between waves so a steady stress run stops allocating */
+vector<float> wavex, wavey, mergedx, mergedy;
+vector<int> waveColour, waveOrder, mergedColour;
+
+/* Capacity for live bricks in the arrays and the merge buffers. The landed prefix is trimmed
+ * once it passes brickTrim and half the arrays, so they never hold more than this, and a
+ * wave's merge swaps buffers of the same capacity. Grows by half again when it does grow. */
+void reserveBricks(size_t live)
+{
+	size_t room = live + max(live, (size_t)brickTrim) + 64;
+	if(brickx.capacity() >= room && mergedx.capacity() >= room)
+		return;
+	room += room/2;
+	brickx.reserve(room); brickBase.reserve(room); brickColour.reserve(room);
+	mergedx.reserve(room); mergedy.reserve(room); mergedColour.reserve(room);
+}
+long stressTicks = 0, stressFrames = 0; double stressReport = 0;
+const int stressShotTicks = 4;       // a shot every 4 ticks, 60 a second
+
+/* --alloc-check [warm-up frames] fails the run if a frame allocates after warming up */
+int allocCheck = 0; int allocWarmup = 600;
+const char *tracePath = NULL;     // --trace <file.json>, builds with TRACE only
+long allocFrame = 0, allocBadFrames = 0;
+
+/* --gl-check [warm-up frames] fails the run if live GL objects of any kind grow after warming up */
+int glCheck = 0; int glWarmup = 120;
+long glCheckFrame = 0, glBadFrames = 0; long glBaseline[glResourceKinds];
+
+void checkGLResources()
+{
+	const GLResourceCounts &gl = glResourceCounts();
+	if(glCheckFrame == glWarmup) {
+		memcpy(glBaseline, gl.live, sizeof(glBaseline));
+		return;
+	}
+	int grew = 0;
+	for(int k=0;k<glResourceKinds;k++)
+		if(gl.live[k] > glBaseline[k]) {
+			printf("gl-check: frame %ld has %ld live %s objects, %ld before\n", glCheckFrame, gl.live[k], glResourceName(k), glBaseline[k]);
+			// each step up is reported once
+			glBaseline[k] = gl.live[k];
+			grew = 1;
+		}
+	glBadFrames += grew;
+}
+
+/* --headless [frames] renders offscreen for a fixed number of frames with the bot playing.
+ * Game time advances exactly 1/60 s per frame, so a run is the same every time. */
+int headless = 0; int headlessFrames = 600; long headlessFrame = 0;
+const double headlessStep = 1/60.0;
+double drawSeconds = 0, drawWorst = 0;
+
+/* --capture <file.y4m> records every frame */
+const char *capturePath = NULL;
+FrameCapture capture;
+
+/* Save states, F5 writes snapshotPath, F9 and --load <file> restore one */
+const char *snapshotPath = "brickShooter.snap";
+vector<char> snapBuffer;
+const char *loadPath = NULL, *savePath = NULL;   // --load at start, --save when the game ends
+int snapshotRequest = 0;  // 1 save, 2 restore, done by the main loop between frames
+int mirrorsDirty = 0;     // mirror VAOs are rebuilt by draw() after a restore
+
+/* --latency times every shot and move from input to the frame showing it finished */
+int latencyMode = 0;
+LatencyProbe *latency = NULL;
+long tickCount = 0;       // ticks simulated since the start
+long frameCount = 0;
+
+/* --pace vsync, uncapped, late or a frame rate to cap at, see framePacer.h */
+FramePacer pacer;
+PaceMode paceMode = paceVsync; double paceFps = 60;
+int paceSet = 0;
+
+/* --tournament <games> runs that many bot games side by side instead of the game */
+int tournamentGames = 0;
+Tournament *tournament = NULL;
+
+/* Game time, glfwGetTime() unless headless */
+double gameClock()
+{
+	if(headless)
+		return headlessFrame*headlessStep;
+	return glfwGetTime();
+}
+
+/* Let go of the GL context, a headless run's is EGL's and a window's is GLFW's */
+void closeGL()
+{
+	glResourcesDetach();
+	if(headless)
+		closeHeadless();
+	else
+		glfwTerminate();
+}
+
+/* The clock input events are stamped with, headless runs have no events and use real time */
+double inputClock()
+{
+	if(headless)
+		return wallClock();
+	return glfwGetTime();
+}
+
+/* A shot requested by the player or the bot, traced by the laser stage */
+int shootRequest = 0;
+float laserSeg[maxLaserSegments][4]; int laserSegments = 0; int newLaser = 0;
+
+/* Sparks when a brick is shot or caught, simulated by a job and drawn in one instanced call */
+ParticleSystem *particles;
+int sparksPerBurst = 48;
+vector<float> particleData(maxParticles*particleFloats); int particleCount = 0;
+/* --spark-bench <n> keeps n sparks alive and reports the wall time per frame once a second */
+int sparkBench = 0; long sparkFrames = 0; double sparkLive = 0, sparkReport = 0;
+
+/* Moving state as it was before the latest step, draw() interpolates from it */
+struct PrevState {
+	float cannonShift;
+	float cannonAngle;
+	float BucShift[2];
+} prevState;
+
 /**************************
  * Customizable functions *
  **************************/
@@ -240,175 +471,144 @@ float minf(float a, float b)
 	return b;
 }
 
-float checkRange(float val, float low, float high)
+float lerpf(float a, float b, float t)
 {
-	if(val>high)
-		return high;
-	if(val<low)
-		return low;
-	return val;
+	return a + (b-a)*t;
 }
 
-void createMirror (int index,float a1,float b1,float angleMir)
+/* One line per mirror, all in one VAO. Called again after the mirrors changed */
+void createMirrors ()
 {
 	glLineWidth(10);
-	mirrorAng[index]=angleMir;
-	mirrorx[index] = a1;
-	mirrory[index] = b1;
-	const GLfloat vertex_buffer_data [] = {
-		a1,b1,0, // vertex 0
-		a1+1.5*cosf(angleMir*M_PI/180.0f),b1+1.5*sinf(angleMir*M_PI/180.0f),0 // vertex 1
-	};
-
-	const GLfloat color_buffer_data [] = {
-		0,0,0, // color 0
-		0,0,0, // color 1
-	};
+	int n = mirrorx.size();
+	GLfloat *ends = frameArena.allocArray<GLfloat>(4*n);
+	for(int i=0;i<n;i++) {
+		int m = angleIndex(mirrorAng[i]);
+		GLfloat *v = &ends[4*i];
+		v[0] = mirrorx[i]; v[1] = mirrory[i];
+		v[2] = mirrorx[i]+mirrorLength*cosIndex(m); v[3] = mirrory[i]+mirrorLength*sinIndex(m);
+	}
+	Vertex *vertices = frameArena.allocArray<Vertex>(2*n);
+	colourVertices(vertices, 2*n, ends, 0, 0, 0);
 
 	// create3DObject creates and returns a handle to a VAO that can be used later
-	mirror[index] = create3DObject(GL_LINES, 2, vertex_buffer_data, color_buffer_data, GL_LINE);
+	if(mirrorLines)
+		updateVertices(mirrorLines, vertices);
+	else
+		mirrorLines = create3DObject(GL_LINES, 2*n, vertices, GL_LINE);
 }
 
-void createLine (int index,float a1,float b1,float a2,float b2)
+/* Just mirror i's line, for dragging one in a level of thousands */
+void updateMirror (int i)
 {
-	glLineWidth(10); nlines++;
-	const GLfloat vertex_buffer_data [] = {
-		a1-0.02,b1-0.02,0, // vertex 1
-		a2-0.02,b2-0.02,0, // vertex 2
-		a2+0.02,b2+0.02,0,//vertex3
-
-		a2+0.02,b2+0.02,0,//vertex3
-		a1+0.02,b1+0.02,0,//vertex4
-		a1-0.02,b1-0.02,0//vertex1
+	int m = angleIndex(mirrorAng[i]);
+	const GLfloat ends[] = {
+		mirrorx[i], mirrory[i],
+		mirrorx[i]+mirrorLength*cosIndex(m), mirrory[i]+mirrorLength*sinIndex(m)
 	};
+	Vertex v[2];
+	colourVertices(v, 2, ends, 0, 0, 0);
+	glBindBuffer (GL_ARRAY_BUFFER, mirrorLines->VertexBuffer);
+	glBufferUpdate (GL_ARRAY_BUFFER, 2*i*sizeof(Vertex), sizeof(v), v);
+}
 
-	const GLfloat color_buffer_data [] = {
-		0,0,1,
-		0,0,1,
-		0,0,1,
-
-		0,0,1,
-		0,0,1,
-		0,0,1
+void createLine (int index,float a1,float b1,float a2,float b2)
+{
+	glLineWidth(10); nlines++;
+	// a thin quad along the segment
+	const GLfloat corners [] = {
+		a1-0.02f,b1-0.02f, // vertex 1
+		a2-0.02f,b2-0.02f, // vertex 2
+		a2+0.02f,b2+0.02f, // vertex 3
+		a1+0.02f,b1+0.02f  // vertex 4
 	};
+	Vertex vertices[4];
+	colourVertices(vertices, 4, corners, 0, 0, 1);
 
 	// create3DObject creates and returns a handle to a VAO that can be used later
-	line[index] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+	if(line[index])
+		updateVertices(line[index], vertices);
+	else
+		line[index] = createQuad(vertices, GL_FILL);
 }
 
-int updatable(float x1, float x2, float xstart, int x4)
+void removeBrick(int i)
 {
-	if(x4==1)
-		if(x1<xstart)
-			return 0;
-	if(x4==-1)
-		if(x1>xstart)
-			return 0;
-	if(abs(x1-xstart)<abs(x2-xstart))
-		return 1;
-	return 0;
+	brickColour[i] = deadBrick;
+	brickChanged.push_back(i);
 }
 
-int find_mirror(float *xbound, float *ybound, float xstart, float ystart, float slope,int xinc,int premirr)
+/* Nearest brick on the segment, chunks are merged in order so ties resolve as a serial scan would */
+int scanBricks(float xstart, float ystart, float slope, int xinc, float *finalx, float *finaly)
 {
-	int toret = 0 ;
-	for(int i=0;i<3;i++)
-	{
-		if(i!=premirr)
-		{
-			float mirrorSlope = tanf(mirrorAng[i]*M_PI/180.0f);
-			float xinter = ( slope*xstart - mirrorSlope*mirrorx[i] - ystart + mirrory[i] ) / (slope - mirrorSlope);
-			float yinter = slope*(xinter - xstart) + ystart ;
-			// printf("intersection point with mirror are %f and %f\n",xinter,yinter);
-			if(updatable(xinter,*xbound,xstart,xinc))
+	int n = brickx.size() - brickHead;
+	int chunks = (n + brickGrain - 1)/brickGrain;
+	int *chunkHit = frameArena.allocArray<int>(chunks);
+	// with one worker parallelFor scans everything as a single chunk and leaves the rest unset
+	for(int c=0;c<chunks;c++)
+		chunkHit[c] = -1;
+	float limit = *finalx;
+	double fallen = fallenAt(simTime);
+	jobs->parallelFor(n, brickGrain, [&](int begin, int end) {
+		float bestx = limit;
+		int best = -1;
+		for(int i=brickHead+begin;i<brickHead+end;i++)
+			if(brickColour[i] != deadBrick && brickOnRay(brickx[i],brickY(i,fallen),xstart,ystart,slope) && updatable(brickx[i],bestx,xstart,xinc))
 			{
-				// printf("Half check\n");
-				if(xinter > mirrorx[i] && xinter < mirrorx[i]+1.5*cosf(mirrorAng[i]*M_PI/180.0f) && yinter > mirrory[i] && yinter < mirrory[i] + 1.5*sinf(mirrorAng[i]*M_PI/180.0f))
-				{
-					// printf("updating\n");
-					*xbound = xinter;
-					*ybound = yinter;
-					toret = i+1;
-				}
+				bestx = brickx[i];
+				best = i;
 			}
+		chunkHit[begin/brickGrain] = best;
+	});
+	int found = -1;
+	for(int c=0;c<chunks;c++)
+		if(chunkHit[c] >= 0 && updatable(brickx[chunkHit[c]],*finalx,xstart,xinc))
+		{
+			found = chunkHit[c];
+			*finalx = brickx[found];
+			*finaly = slope*(brickx[found]-xstart) + ystart ;
 		}
-	}
-	return toret;
+	return found;
 }
 
-void find_boundary(float *xbound, float *ybound, float xstart, float ystart, float slope,int xinc)
+/* Trace a shot, draw() turns the segments into VAOs */
+void shootLaser()
 {
-	*xbound = 4*xinc;
-	*ybound = (*xbound - xstart)*slope + ystart ;
-	return;
-}
-
-void shootLaser(int lineInd, float xstart, float ystart,float angle,int xinc,int mirrornum){                   //more tells if the blocks should have a higer x-cord or not
-	float finalx=0.0,finaly=0.0 ;
-	float slope = tanf(angle*M_PI/180.0f);
-	if(lineInd==0)
-	{
-		xstart = -4 + 0.5*cosf(angle*M_PI/180.0f);
-		ystart = ystart + 0.5*sinf(angle*M_PI/180.0f);
-	}
-	// printf("Starting points are %f %f\n",xstart,ystart);
-	find_boundary(&finalx,&finaly,xstart,ystart,slope,xinc);
-	int ifmirror = find_mirror(&finalx,&finaly,xstart,ystart,slope,xinc,mirrornum);
-	// printf("Boundary points are %f %f\n",finalx,finaly);
-	set<pair<pair<float,float> ,int> >::iterator it;
-	set<pair<pair<float,float> ,int> >::iterator removeindex = rect.end();
-	float x1,y1,tmp;
+	TRACE_ZONE("shootLaser");
+	int removeindex = -1;
+	auto nearestBrick = [&](float xstart, float ystart, float slope, int xinc, float *finalx, float *finaly) {
+		int hit = scanBricks(xstart,ystart,slope,xinc,finalx,finaly);
+		if(hit >= 0)
+			removeindex = hit;
+		return hit >= 0;
+	};
+	auto addLine = [&](float x1, float y1, float x2, float y2) {
+		laserSeg[laserSegments][0] = x1; laserSeg[laserSegments][1] = y1;
+		laserSeg[laserSegments][2] = x2; laserSeg[laserSegments][3] = y2;
+		laserSegments++;
+	};
 	int toadd = 0;
-	for(it=rect.begin();it!=rect.end();it++)
-	{
-		x1 = ((*it).first).first;
-		y1 = ((*it).first).second;
-		int blInd = (*it).second;
-		tmp = slope*(x1-xstart) + ystart ;
-		if(abs(y1-tmp)<=0.20){
-			if(updatable(x1,finalx,xstart,xinc))
-			{
-				finalx=x1;
-				finaly = tmp ;
-				ifmirror=0;
-				removeindex = it;
-				if(BlColour[blInd]>=1)
-					toadd = 20;
-				else
-					toadd = -10;
-			}
-		}
-	}
+	laserSegments = 0;
+	if(traceLaser(cannonShift,cannonAngle,&mirrorx[0],&mirrory[0],&mirrorAng[0],mirrorx.size(),nearestBrick,addLine,
+				level ? &mirrorGrid : NULL))
+		toadd = shotPoints(brickColour[removeindex]);
+	newLaser = 1;
 
 	if(toadd == 20)
 		blackhits++;
 	else if(toadd == -10)
 		wronghits++;
 	score += toadd*100*fallRate;
-	printf("score is %d\n",score);
-	if(removeindex!=rect.end())
-		rect.erase(removeindex);
-	// printf("End points before mirrors are %f %f\n",finalx,finaly);
-	// int ifmirror = find_mirror(&finalx,&finaly,xstart,ystart,slope,xinc,mirrornum);
-	// printf("Is there a mirror : %d\n",ifmirror);
-	if(ifmirror > 0)
-	{
-		// printf("End points after mirrors are %f %f\n",finalx,finaly);
-		createLine(lineInd,xstart,ystart,finalx,finaly);
-		float newangle = 2*mirrorAng[ifmirror-1] - angle ;
-		// printf("angle of line is %f\n",newangle);
-		if(cosf(newangle*M_PI/180.0f) >= 0)
-			return shootLaser(lineInd+1,finalx,finaly,2*mirrorAng[ifmirror-1] - angle ,1,ifmirror-1);
-		// printf("Decreasing x\n");
-		return shootLaser(lineInd+1,finalx,finaly,2*mirrorAng[ifmirror-1] - angle,-1,ifmirror-1);
-	}
-	createLine(lineInd,xstart,ystart,finalx,finaly);
+	if(removeindex >= 0) {
+		particles->emit(brickx[removeindex], brickY(removeindex,fallenAt(simTime)), sparksPerBurst, 3.0f, brickColour[removeindex]);
+		removeBrick(removeindex);
+	}
 	shootStatus = 1;
-	lastShoot = glfwGetTime();
-	return;
+	lastShoot = tickTime;
 }
 
-void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
+/* Applied by the simulation at a tick boundary, see applyInput() */
+void applyKey (int key, int action, int mods)
 {
 	// Function is called first on GLFW_PRESS.
 
@@ -431,12 +631,10 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 				cannonShiftStatus = 0;
 				break;
 			case GLFW_KEY_N:
-				fallRate += 0.005 ;
-				fallRate = checkRange(fallRate,0.01,0.05);
+				setFallRate(checkRange(fallRate + 0.005f,0.01,0.05));
 				break;
 			case GLFW_KEY_M:
-				fallRate -= 0.005 ;
-				fallRate = checkRange(fallRate,0.01,0.05);
+				setFallRate(checkRange(fallRate - 0.005f,0.01,0.05));
 				break;
 			case GLFW_KEY_RIGHT: {
 						     redStatus=0;
@@ -465,11 +663,14 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 	else if (action == GLFW_PRESS) {
 		switch (key) {
 			case GLFW_KEY_SPACE:
-				if(canshoot>=1)
-					shootLaser(0,-3.5,cannonShift,cannonAngle,1,5);
+				if(tickTime - lastShoot >= 1)
+					shootRequest = 1;
 				break;
-			case GLFW_KEY_ESCAPE:
-				quit(window);
+			case GLFW_KEY_F5:
+				snapshotRequest = 1;
+				break;
+			case GLFW_KEY_F9:
+				snapshotRequest = 2;
 				break;
 			case GLFW_KEY_A:
 				cannonRotStatus = 1 ;
@@ -485,17 +686,17 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 				break;
 			case GLFW_KEY_RIGHT: {
 						     keyright = 1;
-						     if((glfwGetKey(window,GLFW_KEY_RIGHT_ALT)||glfwGetKey(window,GLFW_KEY_LEFT_ALT)))
+						     if(mods & GLFW_MOD_ALT)
 							     redStatus=1;
-						     if((glfwGetKey(window,GLFW_KEY_RIGHT_CONTROL)||glfwGetKey(window,GLFW_KEY_LEFT_CONTROL)))
+						     if(mods & GLFW_MOD_CONTROL)
 							     greenStatus=1;
 					     }
 					     break;
 			case GLFW_KEY_LEFT: {
 						    keyleft = 1;
-						    if((glfwGetKey(window,GLFW_KEY_RIGHT_ALT)||glfwGetKey(window,GLFW_KEY_LEFT_ALT)))
+						    if(mods & GLFW_MOD_ALT)
 							    redStatus=-1;
-						    if((glfwGetKey(window,GLFW_KEY_RIGHT_CONTROL)||glfwGetKey(window,GLFW_KEY_LEFT_CONTROL)))
+						    if(mods & GLFW_MOD_CONTROL)
 							    greenStatus=-1;
 					    }
 					    break;
@@ -512,8 +713,8 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 	}
 }
 
-/* Executed for character input (like in text boxes) */
-void keyboardChar (GLFWwindow* window, unsigned int key)
+/* Character input (like in text boxes) */
+void applyChar (unsigned int key)
 {
 	switch (key) {
 		case 'Q':
@@ -526,15 +727,19 @@ void keyboardChar (GLFWwindow* window, unsigned int key)
 }
 
 int mouse_press=0 ; int mouse_right_click = 0; int working = 0 ; float xpre,ypre;
+float cursorx, cursory;
+Pick objSelect = {pickNothing, -1}; float grabx, graby;   // dragged object and where it was grabbed
+void dropObject();
 
-/* Executed when a mouse button is pressed/released */
-void mouseButton (GLFWwindow* window, int button, int action, int mods)
+/* A mouse button was pressed/released */
+void applyButton (int button, int action)
 {
 	switch (button) {
 		case GLFW_MOUSE_BUTTON_LEFT:
 			if (action == GLFW_RELEASE){
 				mouse_press = 0;
 				working = 0;
+				dropObject();
 			}
 			else if (action == GLFW_PRESS) {
 				mouse_press = 1;
@@ -552,7 +757,7 @@ void mouseButton (GLFWwindow* window, int button, int action, int mods)
 	}
 }
 
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+void applyScroll (double yoffset)
 {
 	if(yoffset==-1){
 		maxCoord+=0.05;
@@ -565,6 +770,53 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	return ;
 }
 
+/* The GLFW callbacks only queue the event with its time, the simulation applies it
+ * at the next tick boundary. Nothing in here touches game state. */
+InputQueue inputQueue;
+
+void queueInput (InputType type, int code, int action, int mods, float x, float y)
+{
+	InputEvent e;
+	e.time = glfwGetTime();
+	e.type = type; e.code = code; e.action = action; e.mods = mods;
+	e.x = x; e.y = y;
+	inputQueue.push(e);
+}
+
+/* Executed when a regular key is pressed/released/held-down */
+void keyboard (GLFWwindow* window, int key, int, int action, int mods)
+{
+	// closing the window isn't game state and shouldn't wait for a tick
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+		quit(window);
+		return;
+	}
+	queueInput(inputKey, key, action, mods, 0, 0);
+}
+
+/* Executed for character input (like in text boxes) */
+void keyboardChar (GLFWwindow*, unsigned int key)
+{
+	queueInput(inputChar, key, 0, 0, 0, 0);
+}
+
+/* Executed when a mouse button is pressed/released */
+void mouseButton (GLFWwindow*, int button, int action, int mods)
+{
+	queueInput(inputButton, button, action, mods, 0, 0);
+}
+
+void scroll_callback(GLFWwindow*, double xoffset, double yoffset)
+{
+	queueInput(inputScroll, 0, 0, 0, xoffset, yoffset);
+}
+
+/* Executed when the cursor moves, in window pixels */
+void cursorPosition (GLFWwindow*, double x, double y)
+{
+	queueInput(inputCursor, 0, 0, 0, x, y);
+}
+
 /* Executed when window is resized to 'width' and 'height' */
 /* Modify the bounds of the screen here in glm::ortho or Field of View in glm::Perspective */
 void reshapeWindow (GLFWwindow* window, int wid, int ht)
@@ -572,11 +824,10 @@ void reshapeWindow (GLFWwindow* window, int wid, int ht)
 	int fbwidth=wid, fbheight=ht;
 	/* With Retina display on Mac OS X, GLFW's FramebufferSize
 	   is different from WindowSize */
-	glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+	if(window)
+		glfwGetFramebufferSize(window, &fbwidth, &fbheight);
 	width = wid; height = ht;
 
-	GLfloat fov = 90.0f;
-
 	// sets the viewport of openGL renderer
 	glViewport (0, 0, (GLsizei) fbwidth, (GLsizei) fbheight);
 
@@ -590,208 +841,425 @@ void reshapeWindow (GLFWwindow* window, int wid, int ht)
 
 	// Ortho projection for 2D views
 	Matrices.projection = glm::ortho(-maxCoord+xpan, maxCoord+xpan,-maxCoord+ypan, maxCoord+ypan,0.1f, 500.0f);
+
+	// Compute Camera matrix (view)
+	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
+	//  Don't change unless you are sure!!
+	Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
 }
 
 
-// Creates the rectangle object used in this sample code
-void createRectangle (int index,int colour)
-{
-	int forblack = rand()%3;
-	forblack=(1-forblack%2);
-	forblack = 1;
-	// GL3 accepts only Triangles. Quads are not supported
-	const GLfloat vertex_buffer_data [] = {
-		-0.1,-0.1,0, // vertex 1
-		0.1,-0.1,0, // vertex 2
-		0.1, 0.1,0, // vertex 3
 
-		0.1, 0.1,0, // vertex 3
-		-0.1, 0.1,0, // vertex 4
-		-0.1,-0.1,0  // vertex 1
+void createCannon ()
+{
+	static const GLfloat corners [] = {
+		0,-0.2, // vertex 1
+		0,0.2, // vertex 2
+		0.5,0.1, // vertex 3
+		0.5,-0.1 // vertex 4
 	};
+	Vertex vertices[4];
+	colourVertices(vertices, 4, corners, 0, 0, 0);
+	cannon = createQuad(vertices, GL_FILL);
+}
 
-	const GLfloat color_buffer_data [] = {
-		(1-colour)*forblack,colour*forblack,0, // color 1
-		(1-colour)*forblack,colour*forblack,0,  // color 2
-		(1-colour)*forblack,colour*forblack,0,  // color 3
-
-		(1-colour)*forblack,colour*forblack,0,  // color 3
-		(1-colour)*forblack,colour*forblack,0,  // color 4
-		(1-colour)*forblack,colour*forblack,0,  // color 1
+void createRedBucket (int)
+{
+	static const GLfloat corners [] = {
+		-0.3,-4.0, // vertex 1
+		0.3,-4.0, // vertex 2
+		0.5,-3.5, // vertex 3
+		-0.5,-3.5 // vertex 4
 	};
-
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	BlColour[index]=colour+2*(1-forblack);
-	rectangle[index] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+	Vertex vertices[4];
+	colourVertices(vertices, 4, corners, 1, 0, 0);
+	bucket[0] = createQuad(vertices, GL_FILL);
 }
 
-void createCannon ()
+void createGreenBucket (int)
 {
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		0,-0.2,0, // vertex 1
-		0,0.2,0, // vertex 2
-		0.5, 0.1,0, // vertex 3
-
-		0.5, 0.1,0, // vertex 3
-		0.5, -0.1,0, // vertex 4
-		0,-0.2,0 // vertex 1
+	static const GLfloat corners [] = {
+		-0.3,-4.0, // vertex 1
+		0.3,-4.0, // vertex 2
+		0.5,-3.5, // vertex 3
+		-0.5,-3.5 // vertex 4
 	};
+	Vertex vertices[4];
+	colourVertices(vertices, 4, corners, 0, 1, 0);
+	bucket[1] = createQuad(vertices, GL_FILL);
+}
 
-	static const GLfloat color_buffer_data [] = {
-		0,0,0, // color 1
-		0,0,0, // color 2
-		0,0,0, // color 3
-
-		0,0,0, // color 3
-		0,0,0, // color 4
-		0,0,0  // color 1
+void createBattery()
+{
+	static const GLfloat corners [] = {
+		-3.7,3.7, // vertex 1
+		-3.0,3.7, // vertex 2
+		-3.0,3.2, // vertex 3
+		-3.7,3.2 // vertex 4
 	};
-
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	cannon = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+	Vertex vertices[4];
+	colourVertices(vertices, 4, corners, 0, 0, 0);
+	battery = createQuad(vertices, GL_LINE);
 }
 
-void createRedBucket (int index)
+void createNose()
 {
-	// printf("Creating bucket\n");
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		-0.3,-4.0,0, // vertex 1
-		0.3,-4.0,0, // vertex 2
-		0.5, -3.5,0, // vertex 3
-
-		0.5, -3.5,0, // vertex 3
-		-0.5, -3.5,0, // vertex 4
-		-0.3,-4.0,0  // vertex 1
+	static const GLfloat corners [] = {
+		-3.0,3.55, // vertex 1
+		-2.9,3.55, // vertex 2
+		-2.9,3.40, // vertex 3
+		-3.0,3.40 // vertex 4
 	};
+	Vertex vertices[4];
+	colourVertices(vertices, 4, corners, 0, 0, 0);
+	nose = createQuad(vertices, GL_FILL);
+}
 
-	static const GLfloat color_buffer_data [] = {
-		1,0,0, // color 1
-		1,0,0, // color 2
-		1,0,0, // color 3
-
-		1,0,0, // color 3
-		1,0,0, // color 4
-		1,0,0  // color 1
+void createCharge(float length)
+{
+	const GLfloat corners [] = {
+		-3.6f,3.6f, // vertex 1
+		-3.6f+length*0.5f,3.6f, // vertex 2
+		-3.6f+length*0.5f,3.3f, // vertex 3
+		-3.6f,3.3f // vertex 4
 	};
-	bucket[0] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-	// printf("Created bucket\n");
+	Vertex vertices[4];
+	colourVertices(vertices, 4, corners, 0, 1, 0);
+	if(charge)
+		updateVertices(charge, vertices);
+	else
+		charge = createQuad(vertices, GL_FILL);
 }
 
-void createGreenBucket (int index)
+int checkBucket(float xcord,int colour)
 {
-	// printf("Creating bucket\n");
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		-0.3,-4.0,0, // vertex 1
-		0.3,-4.0,0, // vertex 2
-		0.5, -3.5,0, // vertex 3
-
-		0.5, -3.5,0, // vertex 3
-		-0.5, -3.5,0, // vertex 4
-		-0.3,-4.0,0  // vertex 1
-	};
+	return inBucket(xcord,BucShift[colour]);
+}
 
-	static const GLfloat color_buffer_data [] = {
-		0,1,0, // color 1
-		0,1,0, // color 2
-		0,1,0, // color 3
+/* On-screen HUD. Every glyph is one instance of a quad textured from the atlas baked
+ * by atlasgen, the whole HUD is a single instanced draw. */
+const int maxHudGlyphs = 256;
+const float hudScale = 3;             // screen pixels per atlas texel
+GLProgram hudProgram; GLVertexArray hudVAO; GLBuffer hudInstances; GLTexture hudAtlas;
+GLint hudScreenID, hudGlyphSizeID, hudAtlasStepID, hudColourID;
+GLfloat hudGlyphs[3*maxHudGlyphs]; int hudCount = 0;
+const int hudValues = 7 + glResourceKinds + 1;
+int hudShown[hudValues];              // values the instance buffer was built from
+int glStats = 0;                      // --gl-stats, live GL objects and uploads on the HUD
+
+void initHUD ()
+{
+	memset(hudShown, -1, sizeof(hudShown));
+	hudProgram = LoadShaders( "hud.vert", "hud.frag" );
+	hudScreenID = glGetUniformLocation(hudProgram, "screen");
+	hudGlyphSizeID = glGetUniformLocation(hudProgram, "glyphSize");
+	hudAtlasStepID = glGetUniformLocation(hudProgram, "atlasStep");
+	hudColourID = glGetUniformLocation(hudProgram, "textColor");
+
+	hudAtlas = GLTexture::create();
+	glBindTexture(GL_TEXTURE_2D, hudAtlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, hudAtlasW, hudAtlasH, 0, GL_RED, GL_UNSIGNED_BYTE, hudAtlasPixels);
+	glCountUpload(glTextures, hudAtlasW*hudAtlasH);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	hudVAO = GLVertexArray::create();
+	hudInstances = GLBuffer::create();
+	glBindVertexArray(hudVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, hudInstances);
+	glBufferUpload(GL_ARRAY_BUFFER, sizeof(hudGlyphs), NULL, GL_DYNAMIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glVertexAttribDivisor(0, 1);
+}
 
-		0,1,0, // color 3
-		0,1,0, // color 4
-		0,1,0  // color 1
-	};
-	bucket[1] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-	// printf("Created bucket\n");
+/* Queue a line of text with its top left corner at (x,y) pixels from the top left of the window */
+void hudText (float x, float y, const char *text)
+{
+	float penY = height - y - hudGlyphH*hudScale;
+	for(int i=0; text[i] && hudCount<maxHudGlyphs; i++) {
+		hudGlyphs[3*hudCount] = x + i*(hudGlyphW+1)*hudScale;
+		hudGlyphs[3*hudCount+1] = penY;
+		hudGlyphs[3*hudCount+2] = hudGlyphIndex[text[i] & 127];
+		hudCount++;
+	}
 }
 
-void createBattery()
+/* Rebuild the glyph instances, only when a value on them changed */
+void updateHUD ()
 {
-	static const GLfloat vertex_buffer_data [] = {
-		-3.7,3.7,0, // vertex 1
-		-3.0,3.7,0, // vertex 2
-		-3.0, 3.2,0, // vertex 3
+	// the lines hang from the top right corner, so both window sizes move them
+	int values[hudValues] = {score, collected[0], collected[1], blackhits, wronghits, width, height};
+	const GLResourceCounts &gl = glResourceCounts();
+	if(glStats) {
+		for(int k=0;k<glResourceKinds;k++)
+			values[7+k] = gl.live[k];
+		values[7+glResourceKinds] = (int)(gl.uploaded[glBuffers]/1024);
+	}
+	if(memcmp(values, hudShown, sizeof(values)) == 0)
+		return;
+	memcpy(hudShown, values, sizeof(values));
+
+	char text[64];
+	float right = width - 20*(hudGlyphW+1)*hudScale;
+	hudCount = 0;
+	snprintf(text, sizeof(text), "SCORE %d", score);
+	hudText(right, 10, text);
+	snprintf(text, sizeof(text), "RED %d GREEN %d", collected[0], collected[1]);
+	hudText(right, 10 + 10*hudScale, text);
+	snprintf(text, sizeof(text), "BLACK %d MISS %d", blackhits, wronghits);
+	hudText(right, 10 + 20*hudScale, text);
+	if(glStats) {
+		snprintf(text, sizeof(text), "VAO %ld BUF %ld TEX %ld", gl.live[glVertexArrays], gl.live[glBuffers], gl.live[glTextures]);
+		hudText(right, 10 + 40*hudScale, text);
+		snprintf(text, sizeof(text), "PROGRAM %ld SHADER %ld", gl.live[glPrograms], gl.live[glShaders]);
+		hudText(right, 10 + 50*hudScale, text);
+		snprintf(text, sizeof(text), "UPLOAD %d KB", values[7+glResourceKinds]);
+		hudText(right, 10 + 60*hudScale, text);
+	}
 
-		-3.0, 3.2,0, // vertex 3
-		-3.7,3.2,0, // vertex 4
-		-3.7,3.7,0  // vertex 1
-	};
+	glBindBuffer(GL_ARRAY_BUFFER, hudInstances);
+	glBufferUpdate(GL_ARRAY_BUFFER, 0, 3*hudCount*sizeof(GLfloat), hudGlyphs);
+}
 
-	static const GLfloat color_buffer_data [] = {
-		0,0,0, // color 1
-		0,0,0, // color 1
-		0,0,0, // color 1
+void drawHUD ()
+{
+	updateHUD();
+	glDisable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glUseProgram(hudProgram);
+	glUniform2f(hudScreenID, width, height);
+	glUniform2f(hudGlyphSizeID, hudGlyphW*hudScale, hudGlyphH*hudScale);
+	glUniform2f(hudAtlasStepID, (hudGlyphW+1)/(float)hudAtlasW, hudGlyphW/(float)hudAtlasW);
+	glUniform3f(hudColourID, 1, 1, 1);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, hudAtlas);
+	glBindVertexArray(hudVAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, hudCount);
+	glEnable(GL_DEPTH_TEST);
+}
 
-		0,0,0, // color 1
-		0,0,0, // color 1
-		0,0,0 // color 1
-	};
-	battery = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_LINE);
+/* Particles are quads built from the vertex id, the instance buffer holds one entry per particle */
+GLProgram particleProgram; GLVertexArray particleVAO; GLBuffer particleInstances;
+GLint particleVPID, particleSizeID, particlePaletteID;
+
+void initParticles ()
+{
+	particleProgram = LoadShaders( "particle.vert", "particle.frag" );
+	particleVPID = glGetUniformLocation(particleProgram, "VP");
+	particleSizeID = glGetUniformLocation(particleProgram, "size");
+	particlePaletteID = glGetUniformLocation(particleProgram, "palette");
+
+	particleVAO = GLVertexArray::create();
+	particleInstances = GLBuffer::create();
+	glBindVertexArray(particleVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, particleInstances);
+	glBufferUpload(GL_ARRAY_BUFFER, particleData.size()*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, particleFloats, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glVertexAttribDivisor(0, 1);
 }
 
-void createNose()
+void drawParticles (const glm::mat4 &VP)
 {
-	static const GLfloat vertex_buffer_data [] = {
-		-3.0,3.55,0, // vertex 1
-		-2.9,3.55,0, // vertex 2
-		-2.9,3.40,0, //vertex 3
+	if(particleCount == 0)
+		return;
+	// red and green bricks, the third entry is spare for other effects
+	static const GLfloat palette[] = { 1,0.2f,0.1f, 0.2f,1,0.1f, 0.6f,0.8f,1 };
+	glBindBuffer(GL_ARRAY_BUFFER, particleInstances);
+	// orphan the old storage so we don't wait for last frame's draw
+	glBufferUpload(GL_ARRAY_BUFFER, particleData.size()*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBufferUpdate(GL_ARRAY_BUFFER, 0, particleFloats*particleCount*sizeof(GLfloat), &particleData[0]);
+
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glUseProgram(particleProgram);
+	glUniformMatrix4fv(particleVPID, 1, GL_FALSE, &VP[0][0]);
+	glUniform1f(particleSizeID, 0.03f);
+	glUniform3fv(particlePaletteID, 3, palette);
+	glBindVertexArray(particleVAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, particleCount);
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+}
 
-		-2.9,3.40,0, // vertex 3
-		-3.0,3.40,0, // vertex 4
-		-3.0,3.55,0  // vertex 1
-	};
+/* Bricks are drawn in one instanced call from a buffer that mirrors brickx, brickBase and
+ * brickColour, each array in its own region. The vertex shader puts a brick at its base
+ * less how far bricks have fallen, so nothing is uploaded as they fall: only new bricks
+ * and the ones listed in brickChanged. */
+GLProgram brickProgram; GLVertexArray brickVAO; GLBuffer brickInstances;
+GLint brickVPID, brickFallenID;
+int brickCapacity = 0;       // bricks each region has room for
+int brickUploaded = 0;       // the buffer matches the arrays up to here
 
-	static const GLfloat color_buffer_data [] = {
-		0,0,0, // color 1
-		0,0,0, // color 1
-		0,0,0, // color 1
+void initBricks ()
+{
+	brickProgram = LoadShaders( "brick.vert", "Sample_GL.frag" );
+	brickVPID = glGetUniformLocation(brickProgram, "VP");
+	brickFallenID = glGetUniformLocation(brickProgram, "fallen");
+
+	brickVAO = GLVertexArray::create();
+	brickInstances = GLBuffer::create();
+	glBindVertexArray(brickVAO);
+	for(int i=0;i<3;i++) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribDivisor(i, 1);
+	}
+}
 
-		0,0,0, // color 1
-		0,0,0, // color 1
-		0,0,0 // color 1
-	};
-	nose = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* Bricks [begin, end) into the buffer, which is bound */
+void uploadBricks (int begin, int end)
+{
+	size_t n = (end - begin)*sizeof(GLfloat);
+	glBufferUpdate(GL_ARRAY_BUFFER, begin*sizeof(GLfloat), n, &brickx[begin]);
+	glBufferUpdate(GL_ARRAY_BUFFER, (brickCapacity + begin)*sizeof(GLfloat), n, &brickBase[begin]);
+	glBufferUpdate(GL_ARRAY_BUFFER, (2*brickCapacity + begin)*sizeof(GLint), n, &brickColour[begin]);
 }
 
-void createCharge(float length)
+void drawBricks (const glm::mat4 &VP, float alpha)
 {
-	const GLfloat vertex_buffer_data [] = {
-		-3.6,3.6,0, // vertex 1
-		-3.6+length*0.5,3.6,0, // vertex 2
-		-3.6+length*0.5,3.3,0, // vertex 3
+	TRACE_ZONE("drawBricks");
+	int n = brickx.size();
+	glBindBuffer(GL_ARRAY_BUFFER, brickInstances);
+	if(n > brickCapacity) {
+		brickCapacity = max(2*brickCapacity, max(n, 1024));
+		glBufferUpload(GL_ARRAY_BUFFER, 3*brickCapacity*sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+		bricksDirty = 1;
+	}
+	if(bricksDirty) {
+		brickUploaded = brickHead;
+		brickChanged.clear();
+		bricksDirty = 0;
+	}
+	if(brickUploaded < n)
+		uploadBricks(max(brickUploaded, brickHead), n);
+	brickUploaded = n;
+	for(size_t c=0;c<brickChanged.size();c++)
+		if(brickChanged[c] >= brickHead)
+			uploadBricks(brickChanged[c], brickChanged[c] + 1);
+	brickChanged.clear();
+	if(n == brickHead)
+		return;
+
+	glUseProgram(brickProgram);
+	glUniformMatrix4fv(brickVPID, 1, GL_FALSE, &VP[0][0]);
+	// where the bricks were alpha of the way through the latest step
+	glUniform1f(brickFallenID, (float)fallenAt(simTime - (1-alpha)*simStep));
+	glBindVertexArray(brickVAO);
+	// the attributes start at the front of the queue, the landed bricks before it aren't drawn
+	glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 0, (void*)(brickHead*sizeof(GLfloat)));
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, (void*)((brickCapacity + brickHead)*sizeof(GLfloat)));
+	glVertexAttribIPointer(2, 1, GL_INT, 0, (void*)((2*brickCapacity + brickHead)*sizeof(GLint)));
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n - brickHead);
+}
 
-		-3.6+length*0.5,3.3,0, // vertex 3
-		-3.6,3.3,0, // vertex 4
-		-3.6,3.6,0  // vertex 1
-	};
+/* Every game of a tournament in one instanced draw, see tournament.h. The program,
+ * the quad and the instance buffer are shared by all games. */
+GLProgram tournamentProgram; GLVertexArray tournamentVAO; GLBuffer tournamentInstances;
+GLint tournamentColumnsID, tournamentPaletteID;
+vector<float> tournamentShapes;
 
-	const GLfloat color_buffer_data [] = {
-		0,1,0, // color 1
-		0,1,0, // color 1
-		0,1,0, // color 1
+void initTournament ()
+{
+	tournamentProgram = LoadShaders( "tournament.vert", "particle.frag" );
+	tournamentColumnsID = glGetUniformLocation(tournamentProgram, "columns");
+	tournamentPaletteID = glGetUniformLocation(tournamentProgram, "palette");
+	tournamentShapes.resize(tournament->maxShapes()*shapeFloats);
+
+	tournamentVAO = GLVertexArray::create();
+	tournamentInstances = GLBuffer::create();
+	glBindVertexArray(tournamentVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, tournamentInstances);
+	glBufferUpload(GL_ARRAY_BUFFER, tournamentShapes.size()*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	for(int i=0;i<2;i++) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, shapeFloats*sizeof(GLfloat), (void*)(4*i*sizeof(GLfloat)));
+		glVertexAttribDivisor(i, 1);
+	}
+}
 
-		0,1,0, // color 1
-		0,1,0, // color 1
-		0,1,0 // color 1
-	};
-	charge = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+void drawTournament ()
+{
+	// indexed by ShapePalette
+	static const GLfloat palette[] = { 1,0,0, 0,1,0, 0,0,0, 1,1,1, 0.1f,0.1f,0.4f, 0,0,1 };
+	int count = tournament->shapes(&tournamentShapes[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, tournamentInstances);
+	glBufferUpload(GL_ARRAY_BUFFER, tournamentShapes.size()*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBufferUpdate(GL_ARRAY_BUFFER, 0, shapeFloats*count*sizeof(GLfloat), &tournamentShapes[0]);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glUseProgram(tournamentProgram);
+	glUniform1i(tournamentColumnsID, tournament->columns());
+	glUniform3fv(tournamentPaletteID, 6, palette);
+	glBindVertexArray(tournamentVAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+	glEnable(GL_DEPTH_TEST);
 }
 
-int checkBucket(float xcord,int colour)
+/* The tournament's own loop, fixed steps like the game's but nothing to interpolate */
+void runTournament (GLFWwindow *window)
 {
-	if(xcord<0.5+BucShift[colour] && xcord>BucShift[colour]-0.5)
-		return 1;
-	return 0;
-	// printf("%d\n",score);
+	initTournament();
+	double previous = gameClock(), accumulator = 0;
+	double runStart = wallClock();
+	while(headless ? headlessFrame < headlessFrames : !glfwWindowShouldClose(window)) {
+		pacer.beginFrame();
+		TRACE_ZONE("frame");
+		if(headless)
+			headlessFrame++;
+		else {
+			TRACE_ZONE("poll");
+			glfwPollEvents();
+		}
+		double now = gameClock();
+		accumulator += min(now - previous, 0.25);
+		previous = now;
+		while(accumulator >= simStep) {
+			tournament->tick();
+			accumulator -= simStep;
+		}
+		double drawStart = wallClock();
+		drawTournament();
+		if(headless) {
+			finishHeadlessFrame();
+			drawSeconds += wallClock() - drawStart;
+		}
+		capture.grab(now);
+		pacer.beforeSwap();
+		if(!headless) {
+			TRACE_ZONE("swap");
+			glfwSwapBuffers(window);
+		}
+		pacer.afterSwap();
+	}
+	if(capture.active())
+		capture.stop();
+	tournament->report();
+	pacer.report();
+	if(tracePath)
+		traceWrite();
+	if(headless) {
+		double seconds = wallClock() - runStart;
+		printf("headless: %ld frames in %.2f s, %.1f frames/s, draw %.3f ms/frame\n", headlessFrame, seconds,
+				headlessFrame/seconds, 1000*drawSeconds/headlessFrame);
+		printf("headless: last frame checksum %08x\n", headlessChecksum());
+	}
+	closeGL();
+	exit(EXIT_SUCCESS);
 }
 
 float camera_rotation_angle = 90;
 
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
-void draw (int count)
+void draw (int, float alpha)
 {
+	TRACE_ZONE("draw");
 	// clear the color and depth in the frame buffer
 	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -800,16 +1268,14 @@ void draw (int count)
 	glUseProgram (programID);
 
 	// Eye - Location of camera. Don't change unless you are sure!!
-	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
+	int cameraAngle = angleIndex(camera_rotation_angle);
+	glm::vec3 eye ( 5*cosIndex(cameraAngle), 0, 5*sinIndex(cameraAngle) );
 	// Target - Where is the camera looking at.  Don't change unless you are sure!!
 	glm::vec3 target (0, 0, 0);
 	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
 	glm::vec3 up (0, 1, 0);
 
-	// Compute Camera matrix (view)
-	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-	//  Don't change unless you are sure!!
-	Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+	// Camera matrix (view) is set up in reshapeWindow along with the projection
 
 	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
 	//  Don't change unless you are sure!!
@@ -820,13 +1286,18 @@ void draw (int count)
 	//  Don't change unless you are sure!!
 	glm::mat4 MVP;	// MVP = Projection * View * Model
 
-	for(int i=0;i<3;i++)
+	if(mirrorsDirty)
 	{
-		Matrices.model = glm::mat4(1.0f);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(mirror[i]);
+		createMirrors();
+		mirrorsDirty = 0;
 	}
+	else if(mirrorMoved >= 0)
+		updateMirror(mirrorMoved);
+	mirrorMoved = -1;
+	Matrices.model = glm::mat4(1.0f);
+	MVP = VP * Matrices.model;
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+	draw3DObject(mirrorLines);
 
 	Matrices.model = glm::mat4(1.0f);
 	MVP = VP * Matrices.model;
@@ -846,7 +1317,7 @@ void draw (int count)
 	for(int i=0;i<2;i++)
 	{
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateBucket = glm::translate (glm::vec3(BucShift[i],0.0f, 0.0f));
+		glm::mat4 translateBucket = glm::translate (glm::vec3(lerpf(prevState.BucShift[i],BucShift[i],alpha),0.0f, 0.0f));
 		Matrices.model *= translateBucket ;
 		MVP = VP * Matrices.model;
 		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
@@ -854,8 +1325,12 @@ void draw (int count)
 	}
 
 	Matrices.model = glm::mat4(1.0f);
-	glm::mat4 rotateCannon = glm::rotate((float)(cannonAngle*M_PI/180.0f), glm::vec3(0,0,1));
-	glm::mat4 translateCannon = glm::translate (glm::vec3(-4.0f,cannonShift, 0.0f)); // glTranslatef
+	// rotation about z straight from the tables, in between two steps is below a table step anyway
+	int drawAngle = angleIndex(lerpf(prevState.cannonAngle,cannonAngle,alpha));
+	glm::mat4 rotateCannon(1.0f);
+	rotateCannon[0][0] = cosIndex(drawAngle); rotateCannon[0][1] = sinIndex(drawAngle);
+	rotateCannon[1][0] = -sinIndex(drawAngle); rotateCannon[1][1] = cosIndex(drawAngle);
+	glm::mat4 translateCannon = glm::translate (glm::vec3(-4.0f,lerpf(prevState.cannonShift,cannonShift,alpha), 0.0f)); // glTranslatef
 	// rotate about vector (1,0,0)
 	glm::mat4 cannonTransform = translateCannon*rotateCannon;
 	Matrices.model *= cannonTransform;
@@ -863,6 +1338,13 @@ void draw (int count)
 	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
 	draw3DObject(cannon);
 
+	if(newLaser)
+	{
+		nlines = 0;
+		for(int i=0;i<laserSegments;i++)
+			createLine(i,laserSeg[i][0],laserSeg[i][1],laserSeg[i][2],laserSeg[i][3]);
+		newLaser = 0;
+	}
 	if(shootStatus>=0)
 	{
 		for(int i=0;i<nlines;i++)
@@ -881,44 +1363,10 @@ void draw (int count)
 	/* Render your scene */
 	// Pop matrix to undo transformations till last push matrix instead of recomputing model matrix
 	// glPopMatrix ();
-	set<pair<pair<float, float> ,int> >::iterator it ;
-	for(it = rect.begin(); it != rect.end(); it++)
-	{
-		float f1 = ((*it).first).first;
-		float f2 = ((*it).first).second;
-		int ind = (*it).second;
-		if(f2<=-3.4)
-		{
-			int tmp = 0;
-			// printf("reached\n");
-			if(BlColour[ind]>1)
-			{
-				tmp = checkBucket(f1,0) + checkBucket(f1,1);
-				if(tmp>0)
-					gameon = 0;
-			}
-			else{
-				if(checkBucket(f1,BlColour[ind]) == 1){
-					score += 1000*fallRate;
-					collected[BlColour[ind]]++;
-				}
-			}
-			rect.erase(it);
-			printf("score is %d\n",score);
-		}
-		else
-		{
-			//printf("Drawing for %d with ycord as %f\n",ind,f2);
-			Matrices.model = glm::mat4(1.0f);
-			glm::mat4 translateRectangle = glm::translate (glm::vec3(f1,f2, 0));        // glTranslatef
-			Matrices.model *= (translateRectangle);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+	drawBricks(VP, alpha);
 
-			// draw3DObject draws the VAO given to it using current MVP matrix
-			draw3DObject(rectangle[ind]);
-		}
-	}
+	drawParticles(VP);
+	drawHUD();
 
 }
 
@@ -947,7 +1395,6 @@ GLFWwindow* initGLFW (int width, int height)
 
 	glfwMakeContextCurrent(window);
 	gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
-	glfwSwapInterval( 1 );
 
 	/* --- register callbacks with GLFW --- */
 
@@ -967,12 +1414,35 @@ GLFWwindow* initGLFW (int width, int height)
 	/* Register function to handle mouse click */
 	glfwSetMouseButtonCallback(window, mouseButton);  // mouse button clicks
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetCursorPosCallback(window, cursorPosition);
 
 	return window;
 }
 
 /* Initialize the OpenGL rendering properties */
 /* Add all the models to be created here */
+/* Rails, spawns and mirrors of a compiled level. Nothing to build, the grid is in the file */
+void applyLevel (const LevelHeader *l)
+{
+	cannonMin = l->cannonMin; cannonMax = l->cannonMax;
+	cannonShift = checkRange(0, cannonMin, cannonMax);
+	for(int i=0;i<2;i++) {
+		BucShift[i] = l->bucketStart[i];
+		bucketMin[i] = l->bucketMin[i]; bucketMax[i] = l->bucketMax[i];
+	}
+	spawnMin = l->spawnMin; spawnMax = l->spawnMax;
+	colourWeight[0] = l->colourWeight[0]; colourWeight[1] = l->colourWeight[1];
+	int n = l->mirrorCount;
+	const LevelMirror *m = levelMirrors(l);
+	mirrorx.resize(n); mirrory.resize(n); mirrorAng.resize(n);
+	for(int i=0;i<n;i++) {
+		mirrorx[i] = m[i].x; mirrory[i] = m[i].y;
+		mirrorAng[i] = m[i].angle == randomAngle ? rand()%89+1 : m[i].angle;
+	}
+	mirrorGrid = levelGrid(l);
+	nextFall = 0;
+}
+
 void initGL (GLFWwindow* window, int width, int height)
 {
 	/* Objects should be created before any other gl function and shaders */
@@ -983,16 +1453,30 @@ void initGL (GLFWwindow* window, int width, int height)
 	createGreenBucket(1);
 	createBattery();
 	createNose();
-	BucShift[0]-=1;
-	BucShift[1]+= 1;
-	createMirror(0,-2,0,rand()%89+1);
-	//printf("xstart is %f ystart is %f and slope is %f",mirrorx[0],mirrory[0],mirrorAng[0]);
-	createMirror(1,2.5,-2,rand()%89+1) ;
-	createMirror(2,-0.5,-3,rand()%89+1);
+	// a few bricks are ever live in play, the stress waves reserve their own
+	reserveBricks(64);
+	if(level)
+		applyLevel(level);
+	else {
+		BucShift[0]-=1;
+		BucShift[1]+= 1;
+		for(int i=0;i<numMirrors;i++) {
+			mirrorx.push_back(mirrorStartX[i]); mirrory.push_back(mirrorStartY[i]);
+			mirrorAng.push_back(rand()%89+1);
+		}
+	}
+	createMirrors();
+	// every laser segment's VAO up front, the first bounced shot shouldn't make GL objects
+	for(int i=0;i<5;i++)
+		createLine(i,0,0,0,0);
+	nlines = 0;
 	// Create and compile our GLSL program from the shaders
 	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
 	// Get a handle for our "MVP" uniform
 	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+	initHUD();
+	initParticles();
+	initBricks();
 
 
 	reshapeWindow (window, width, height);
@@ -1010,157 +1494,873 @@ void initGL (GLFWwindow* window, int width, int height)
 	cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
-int findObject(float xcord,float ycord)
+/* The cursor in world coordinates, through the inverse of the current view-projection */
+void cursorWorld(float *x, float *y)
+{
+	glm::mat4 inverseVP = glm::inverse(Matrices.projection * Matrices.view);
+	glm::vec4 ndc(2*cursorx/width - 1, 1 - 2*cursory/height, 0, 1);
+	glm::vec4 world = inverseVP * ndc;
+	*x = world.x/world.w;
+	*y = world.y/world.w;
+}
+
+Pick findObject(float xcord,float ycord)
 {
-	if(ycord<-3.6){
-		if(checkBucket(xcord,0))
-			return 1;
-		if(checkBucket(xcord,1))
-			return 2;
+	PickScene scene;
+	scene.bucketShift[0] = BucShift[0]; scene.bucketShift[1] = BucShift[1];
+	scene.cannonShift = cannonShift;
+	scene.brickx = &brickx[0]; scene.brickBase = &brickBase[0]; scene.brickColour = &brickColour[0];
+	scene.brickFallen = fallenAt(simTime);
+	scene.brickBegin = brickHead; scene.brickEnd = brickx.size();
+	scene.mirrorx = &mirrorx[0]; scene.mirrory = &mirrory[0]; scene.mirrorAng = &mirrorAng[0];
+	scene.numMirrors = mirrorx.size();
+	scene.grid = level ? &mirrorGrid : NULL;
+	Pick p = pickAt(scene, xcord, ycord);
+	if(p.kind == pickBrick) {
+		grabx = xcord - brickx[p.index];
 	}
-	if(xcord<-3.4){
-		if(abs(ycord - cannonShift ) <= 0.5)
-			return 3;
+	else if(p.kind == pickMirror) {
+		grabx = xcord - mirrorx[p.index]; graby = ycord - mirrory[p.index];
+		// its cells go stale as it moves, the laser tests it on its own until it is let go
+		if(level)
+			mirrorGrid.loose = p.index;
 	}
-	return 0;
+	return p;
+}
+
+/* The mirror grid after a drag, built from the mirrors as they are now */
+void rebuildMirrorGrid()
+{
+	vector<LevelMirror> mirrors(mirrorx.size());
+	for(size_t i=0;i<mirrors.size();i++) {
+		mirrors[i].x = mirrorx[i]; mirrors[i].y = mirrory[i]; mirrors[i].angle = mirrorAng[i];
+	}
+	buildMirrorGrid(&mirrors[0], mirrors.size(), gridStart, gridMirrors, mirrorGrid);
 }
 
-void moveObject(int obnumber,float xcord,float ycord)
+/* Let go of whatever was dragged */
+void dropObject()
 {
-	//printf("Moving object %d at coord %f %f\n",obnumber,xcord,ycord);
-	if(obnumber==1 || obnumber==2 ){
-		BucShift[obnumber-1]=(xcord);
-		BucShift[obnumber-1] = checkRange(BucShift[obnumber-1],-4,4);
+	if(objSelect.kind == pickMirror && level)
+		rebuildMirrorGrid();
+	objSelect.kind = pickNothing;
+}
+
+void moveObject(Pick ob,float xcord,float ycord)
+{
+	switch(ob.kind) {
+		case pickBucket:
+			BucShift[ob.index] = checkRange(xcord,bucketMin[ob.index],bucketMax[ob.index]);
+			break;
+		case pickCannon:
+			cannonShift = checkRange(ycord,cannonMin,cannonMax);
+			break;
+		case pickBrick:
+			// sideways only, the height is what keeps the bricks in landing order
+			if(brickColour[ob.index] != deadBrick && ob.index >= brickHead)
+			{
+				brickx[ob.index] = checkRange(xcord - grabx,-4,4);
+				brickChanged.push_back(ob.index);
+			}
+			break;
+		case pickMirror:
+			mirrorx[ob.index] = checkRange(xcord - grabx,-4,4);
+			mirrory[ob.index] = checkRange(ycord - graby,-4,4);
+			mirrorMoved = ob.index;
+			break;
+		case pickNothing:
+			cannonAngle = snapAngle(atanf((ycord-cannonShift)/(xcord+4))*180.0f/M_PI);
+			break;
 	}
-	if(obnumber==3){
-		cannonShift=(ycord);
-		cannonShift = checkRange(cannonShift,-3.4,4);
+}
+
+/* Shots and cannon moves are what the latency probe times, -1 for anything else */
+int latencyKind (const InputEvent *e)
+{
+	if(e->type == inputKey && e->action == GLFW_PRESS)
+		switch (e->code) {
+			case GLFW_KEY_SPACE:
+				return latencyShot;
+			case GLFW_KEY_A: case GLFW_KEY_D: case GLFW_KEY_S: case GLFW_KEY_F:
+			case GLFW_KEY_LEFT: case GLFW_KEY_RIGHT:
+				return latencyMove;
+		}
+	// dragging a mirror or bucket
+	if(e->type == inputCursor && mouse_press == 1)
+		return latencyMove;
+	return -1;
+}
+
+/* Apply every queued event that arrived before time, the start of the tick about to run */
+void applyInput (double time)
+{
+	const InputEvent *e;
+	while((e = inputQueue.front()) && e->time <= time)
+	{
+		if(latency && latencyKind(e) >= 0)
+			latency->inputApplied(e->time, tickCount, (LatencyKind)latencyKind(e));
+		switch (e->type) {
+			case inputKey:
+				applyKey(e->code, e->action, e->mods);
+				break;
+			case inputChar:
+				applyChar(e->code);
+				break;
+			case inputButton:
+				applyButton(e->code, e->action);
+				break;
+			case inputScroll:
+				applyScroll(e->y);
+				break;
+			case inputCursor:
+				cursorx = e->x; cursory = e->y;
+				break;
+		}
+		inputQueue.pop();
 	}
-	if(obnumber==0){
-		cannonAngle = atanf((ycord-cannonShift)/(xcord+4))*180.0f/M_PI;
+	// dragging follows the cursor as of this tick
+	if(mouse_press==1)
+	{
+		float mouse_x, mouse_y;
+		cursorWorld(&mouse_x, &mouse_y);
+		if(working==0){
+			objSelect = findObject(mouse_x,mouse_y);
+			working = 1;
+		}
+		else
+			moveObject(objSelect,mouse_x,mouse_y);
 	}
-	return;
 }
 
-void pushDown(){
-	set<pair<pair<float, float> ,int> >::iterator it ;
-	for(it = rect.begin(); it != rect.end(); it++){
-		float tmp1 = ((*it).first).first ;
-		float tmp2 = (((*it).first).second-fallRate);
-		int tmp3 = (*it).second;
-		rect.erase(it);
-		rect.insert(make_pair(make_pair(tmp1,tmp2),tmp3));
+/* Move the bases and the fall line back by how far bricks have fallen, rare enough
+ * that it doesn't matter it touches every brick */
+void rebaseBricks()
+{
+	TRACE_ZONE("rebaseBricks");
+	float drop = (float)fallenAt(simTime);
+	jobs->parallelFor(brickBase.size() - brickHead, brickGrain, [drop](int begin, int end) {
+		for(int i=brickHead+begin;i<brickHead+end;i++)
+			brickBase[i] -= drop;
+	});
+	fallFrom -= drop;
+	bricksDirty = 1;
+}
+
+/* Score the bricks that reached the buckets, only the front of the queue can have */
+void landBricks()
+{
+	int n = brickBase.size();
+	double fallen = fallenAt(simTime);
+	while(brickHead < n && brickY(brickHead,fallen) <= landY)
+	{
+		float f1 = brickx[brickHead];
+		int colour = brickColour[brickHead];
+		brickHead++;
+		if(colour == deadBrick)
+			continue;
+		if(colour>1)
+		{
+			if(checkBucket(f1,0) + checkBucket(f1,1) > 0)
+				gameon = 0;
+		}
+		else{
+			if(checkBucket(f1,colour) == 1){
+				score += 1000*fallRate;
+				collected[colour]++;
+				particles->emit(f1, landY, sparksPerBurst/2, 2.0f, colour);
+			}
+		}
+	}
+	// drop the landed prefix once it outweighs the live bricks
+	if(brickHead > 1024 && brickHead > n/2) {
+		brickx.erase(brickx.begin(), brickx.begin()+brickHead);
+		brickBase.erase(brickBase.begin(), brickBase.begin()+brickHead);
+		brickColour.erase(brickColour.begin(), brickColour.begin()+brickHead);
+		// a dragged brick moves down with the rest, it can't be in the landed part
+		if(objSelect.kind == pickBrick)
+			objSelect.index -= brickHead;
+		brickHead = 0;
+		bricksDirty = 1;
 	}
 }
 
 void makeChanges()
 {
+	TRACE_ZONE("makeChanges");
 	if(cannonShiftStatus != 0)
 	{
-		cannonShift += ((float)cannonShiftStatus)*0.02 ;
-		cannonShift = checkRange(cannonShift,-3.4,4);
+		cannonShift += ((float)cannonShiftStatus)*cannonSpeed*stepScale ;
+		cannonShift = checkRange(cannonShift,cannonMin,cannonMax);
 	}
 	if(cannonRotStatus != 0)
 	{
-		cannonAngle += ((float)cannonRotStatus)*0.2;
-		cannonAngle = checkRange(cannonAngle,-90,90);
+		cannonAngle += ((float)cannonRotStatus)*cannonTurn*stepScale;
+		cannonAngle = snapAngle(checkRange(cannonAngle,-90,90));
 	}
 	if(redStatus!=0)
 	{
-		BucShift[0] += ((float)redStatus)*0.02;
-		BucShift[0] = checkRange(BucShift[0],-4,4);
+		BucShift[0] += ((float)redStatus)*bucketSpeed*stepScale;
+		BucShift[0] = checkRange(BucShift[0],bucketMin[0],bucketMax[0]);
 	}
 	if(greenStatus!=0)
 	{
-		BucShift[1] += ((float)greenStatus)*0.02;
-		BucShift[1] = checkRange(BucShift[1],-4,4);
+		BucShift[1] += ((float)greenStatus)*bucketSpeed*stepScale;
+		BucShift[1] = checkRange(BucShift[1],bucketMin[1],bucketMax[1]);
 	}
 
 	if(mouse_right_click && keyright){
-		xpan+=0.05;
+		xpan+=0.05*stepScale;
 		if(xpan + maxCoord > 4)
-			xpan -= 0.05;
+			xpan -= 0.05*stepScale;
 	}
 	if(mouse_right_click && keyleft){
-		xpan-=0.05;
+		xpan-=0.05*stepScale;
 		if(xpan - maxCoord < -4)
-			xpan += 0.05;
+			xpan += 0.05*stepScale;
 	}
 	if(mouse_right_click && keyup){
-		ypan+=0.05;
+		ypan+=0.05*stepScale;
 		if(ypan + maxCoord > 4)
-			ypan -= 0.05;
+			ypan -= 0.05*stepScale;
 	}
 	if(mouse_right_click && keydown){
-		ypan-=0.05;
+		ypan-=0.05*stepScale;
 		if(ypan - maxCoord < -4)
-			ypan += 0.05;
+			ypan += 0.05*stepScale;
 	}
 	if(keydown && !mouse_right_click){
-		maxCoord+=0.05;
+		maxCoord+=0.05*stepScale;
 		maxCoord = checkRange(maxCoord,1,4);
 	}
 
 	if(keyup && !mouse_right_click){
-		maxCoord-=0.05;
+		maxCoord-=0.05*stepScale;
 		maxCoord = checkRange(maxCoord,1,4);
 	}
 
 }
 
+int spawnRand()
+{
+	spawnRng ^= spawnRng << 13;
+	spawnRng ^= spawnRng >> 17;
+	spawnRng ^= spawnRng << 5;
+	return (int)(spawnRng >> 1);
+}
+
+void spawnBrick()
+{
+	TRACE_ZONE("spawnBrick");
+	// the classic weights and range give the same bricks as always
+	brickColour.push_back(spawnRand()%(colourWeight[0]+colourWeight[1]) < colourWeight[0] ? 0 : 1);
+	brickx.push_back(spawnXIn(spawnRand(), spawnMin, spawnMax));
+	brickBase.push_back(spawnY + fallenAt(simTime));
+	count_rectangles++;
+}
+
+void savePrevState()
+{
+	prevState.cannonShift = cannonShift;
+	prevState.cannonAngle = cannonAngle;
+	prevState.BucShift[0] = BucShift[0];
+	prevState.BucShift[1] = BucShift[1];
+}
+
+/* Everything the game needs to carry on from this point, in snapBuffer */
+GameSnapshot *saveState()
+{
+	int n = brickx.size() - brickHead, mirrors = mirrorx.size();
+	snapBuffer.resize(snapshotSize(n, mirrors));
+	GameSnapshot *snap = (GameSnapshot*)&snapBuffer[0];
+	memcpy(snap->magic, snapshotMagic, sizeof(snapshotMagic));
+	snap->version = snapshotVersion;
+	snap->brickCount = n;
+	snap->mirrorCount = mirrors;
+	snap->nextFall = nextFall;
+	snap->size = snapshotSize(n, mirrors);
+	snap->simTime = simTime; snap->newRecTime = newRec_time;
+	snap->shotAge = gameClock() - lastShoot;
+	snap->cannonShift = cannonShift; snap->cannonAngle = cannonAngle;
+	snap->BucShift[0] = BucShift[0]; snap->BucShift[1] = BucShift[1];
+	snap->fallRate = fallRate; snap->lastDrop = lastDrop;
+	float *m = snapshotMirrors(snap);
+	for(int i=0;i<mirrors;i++) {
+		m[3*i] = mirrorx[i]; m[3*i+1] = mirrory[i]; m[3*i+2] = mirrorAng[i];
+	}
+	snap->score = score; snap->collected[0] = collected[0]; snap->collected[1] = collected[1];
+	snap->blackhits = blackhits; snap->wronghits = wronghits;
+	snap->countRectangles = count_rectangles;
+	snap->rng = spawnRng;
+	if(n > 0) {
+		memcpy(snapshotBrickx(snap), &brickx[brickHead], n*sizeof(float));
+		double fallen = fallenAt(simTime);
+		for(int i=0;i<n;i++)
+			snapshotBricky(snap)[i] = brickY(brickHead+i,fallen);
+		for(int i=0;i<n;i++)
+			snapshotColour(snap)[i] = brickColour[brickHead+i];
+	}
+	return snap;
+}
+
+/* Load a snapshot, GL objects that depend on it are rebuilt when next drawn */
+void restoreState(const GameSnapshot *snap)
+{
+	simTime = snap->simTime; newRec_time = snap->newRecTime;
+	lastShoot = gameClock() - snap->shotAge;
+	cannonShift = snap->cannonShift; cannonAngle = snap->cannonAngle;
+	BucShift[0] = snap->BucShift[0]; BucShift[1] = snap->BucShift[1];
+	fallRate = snap->fallRate; lastDrop = snap->lastDrop;
+	const float *m = snapshotMirrors(snap);
+	for(size_t i=0;i<mirrorx.size();i++) {
+		mirrorx[i] = m[3*i]; mirrory[i] = m[3*i+1]; mirrorAng[i] = m[3*i+2];
+	}
+	nextFall = snap->nextFall;
+	score = snap->score; collected[0] = snap->collected[0]; collected[1] = snap->collected[1];
+	blackhits = snap->blackhits; wronghits = snap->wronghits;
+	count_rectangles = snap->countRectangles;
+	spawnRng = snap->rng;
+	int n = snap->brickCount;
+	brickx.assign(snapshotBrickx(snap), snapshotBrickx(snap) + n);
+	// the saved heights become the bases, nothing has fallen yet
+	brickBase.assign(snapshotBricky(snap), snapshotBricky(snap) + n);
+	fallAt = simTime; fallFrom = 0;
+	bricksDirty = 1;
+	brickColour.assign(snapshotColour(snap), snapshotColour(snap) + n);
+	brickHead = 0;
+	// nothing to interpolate from or to
+	savePrevState();
+	nlines = 0; newLaser = 0; shootRequest = 0;
+	mirrorsDirty = 1;
+	// whatever was being dragged may not be there any more
+	objSelect.kind = pickNothing;
+	if(level)
+		rebuildMirrorGrid();
+}
+
+void saveSnapshotFile(const char *path)
+{
+	GameSnapshot *snap = saveState();
+	if(writeSnapshot(path, snap))
+		printf("snapshot: saved %u bricks to %s\n", snap->brickCount, path);
+}
+
+int loadSnapshotFile(const char *path)
+{
+	const GameSnapshot *snap = mapSnapshot(path);
+	if(!snap)
+		return 0;
+	// the mirror grid belongs to the level, a save from another level can't use it
+	if(snap->mirrorCount != mirrorx.size()) {
+		fprintf(stderr, "snapshot: %s has %u mirrors, this level %d\n", path, snap->mirrorCount, (int)mirrorx.size());
+		unmapSnapshot(snap);
+		return 0;
+	}
+	restoreState(snap);
+	printf("snapshot: restored %u bricks from %s\n", snap->brickCount, path);
+	unmapSnapshot(snap);
+	return 1;
+}
+
+/* Bot player, started with --bot */
+int botMode = 0;
+ThreadPool *botPool; AutoAim *botAim;
+AimResult botTarget; int botTicks = 0;
+int botCandidates = 4096;
+const int botSolveEvery = 15;           // steps between two solves
+const double botBudget = 0.004;         // seconds per solve, a quarter of a 60 fps frame
+long botEvaluations = 0; double botSeconds = 0, botReport = 0;
+/* --min-score <n> fails a headless run that ends below n, to check the bot still scores */
+int minScoreCheck = 0, minScore = 0;
+
+void botSolve()
+{
+	AimSnapshot snap;
+	snap.cannonShift = cannonShift; snap.cannonAngle = cannonAngle;
+	snap.cannonMin = cannonMin; snap.cannonMax = cannonMax;
+	snap.charge = minf((float)(tickTime - lastShoot),1.0f); snap.fallRate = fallRate;
+	snap.mirrorx = &mirrorx[0]; snap.mirrory = &mirrory[0]; snap.mirrorAng = &mirrorAng[0];
+	snap.numMirrors = mirrorx.size();
+	snap.grid = level ? &mirrorGrid : NULL;
+	snap.numBricks = 0;
+	double fallen = fallenAt(simTime);
+	for(size_t i=brickHead;i<brickx.size() && snap.numBricks<aimMaxBricks;i++) {
+		if(brickColour[i] == deadBrick)
+			continue;
+		snap.brickx[snap.numBricks] = brickx[i];
+		snap.bricky[snap.numBricks] = brickY(i,fallen);
+		snap.brickColour[snap.numBricks] = brickColour[i];
+		snap.numBricks++;
+	}
+	botTarget = botAim->solve(snap, botCandidates, rand());
+
+	// size the next solve to the frame budget, headless runs keep it fixed to stay reproducible
+	if(headless)
+		return;
+	double rate = botTarget.evaluations/(botTarget.seconds > 0 ? botTarget.seconds : 1e-6);
+	botCandidates = (int)checkRange(rate*botBudget, 256, 1<<18);
+	botEvaluations += botTarget.evaluations; botSeconds += botTarget.seconds;
+	if(simTime - botReport >= 1 && botSeconds > 0) {
+		printf("bot: %.0f evaluations/s, %d candidates per solve\n", botEvaluations/botSeconds, botCandidates);
+		botEvaluations = 0; botSeconds = 0; botReport = simTime;
+	}
+}
+
+/* Steer the cannon towards the last solution and fire when it is lined up */
+void botControl()
+{
+	if(botTicks-- <= 0) {
+		botSolve();
+		botTicks = botSolveEvery;
+	}
+	// a target off the rail would never be reached, the nearest end of it is as close as the cannon gets
+	float dshift = checkRange(botTarget.cannonShift, cannonMin, cannonMax) - cannonShift;
+	float dangle = botTarget.cannonAngle - cannonAngle;
+	cannonShiftStatus = std::abs(dshift) < cannonSpeed*stepScale ? 0 : (dshift > 0 ? 1 : -1);
+	cannonRotStatus = std::abs(dangle) < cannonTurn*stepScale ? 0 : (dangle > 0 ? 1 : -1);
+	if(botTarget.value > 0 && cannonShiftStatus == 0 && cannonRotStatus == 0 && tickTime - lastShoot >= 1) {
+		shootRequest = 1;
+		botTicks = 0;
+	}
+}
+
+/* Add a wave of stressBricks over the whole height, so the load stays sustained while it falls */
+void spawnWave()
+{
+	std::uniform_real_distribution<float> across(-4, 4), height(landY, spawnY), jitter(-0.05, 0.05);
+	std::normal_distribution<float> spread(0, 0.3);
+	std::uniform_int_distribution<int> colour(0, 1);
+	float centrex[16], centrey[16];
+	double fallen = fallenAt(simTime);
+	for(int i=0;i<16;i++) {
+		centrex[i] = across(stressRng);
+		centrey[i] = height(stressRng);
+	}
+	wavex.resize(stressBricks); wavey.resize(stressBricks);
+	waveColour.resize(stressBricks);
+	for(int i=0;i<stressBricks;i++) {
+		float x, y;
+		if(stressPattern == "clustered") {
+			// gaussian blobs around 16 centres
+			int c = i%16;
+			x = checkRange(centrex[c] + spread(stressRng), -4, 4);
+			y = checkRange(centrey[c] + spread(stressRng), landY, spawnY);
+		}
+		else if(stressPattern == "columns") {
+			// 8 narrow columns, as if every brick of a burst shared a spawn point
+			x = centrex[i%8] + jitter(stressRng);
+			y = height(stressRng);
+		}
+		else {
+			x = across(stressRng);
+			y = height(stressRng);
+		}
+		wavex[i] = x;
+		wavey[i] = y + fallen;
+		waveColour[i] = colour(stressRng);
+	}
+
+	// merge into the queue so it stays in landing order
+	vector<int> &order = waveOrder;
+	order.resize(stressBricks);
+	for(int i=0;i<stressBricks;i++)
+		order[i] = i;
+	sort(order.begin(), order.end(), [&](int a, int b) { return wavey[a] < wavey[b]; });
+	int n = brickBase.size();
+	reserveBricks(n - brickHead + stressBricks);
+	mergedx.clear(); mergedy.clear(); mergedColour.clear();
+	int i = brickHead, w = 0;
+	while(i < n || w < stressBricks) {
+		if(w == stressBricks || (i < n && brickBase[i] <= wavey[order[w]])) {
+			if(brickColour[i] != deadBrick) {
+				mergedx.push_back(brickx[i]); mergedy.push_back(brickBase[i]); mergedColour.push_back(brickColour[i]);
+			}
+			i++;
+		}
+		else {
+			int b = order[w++];
+			mergedx.push_back(wavex[b]); mergedy.push_back(wavey[b]); mergedColour.push_back(waveColour[b]);
+		}
+	}
+	brickx.swap(mergedx); brickBase.swap(mergedy); brickColour.swap(mergedColour);
+	brickHead = 0;
+	bricksDirty = 1;
+	if(objSelect.kind == pickBrick)
+		objSelect.kind = pickNothing;
+}
+
+/* Resident memory in bytes */
+long residentMemory()
+{
+	long pages = 0, resident = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if(statm) {
+		if(fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+			resident = 0;
+		fclose(statm);
+	}
+	return resident*sysconf(_SC_PAGESIZE);
+}
+
+/* Waves and a shot every stressShotTicks regardless of the charge. Both are keyed on the
+ * tick, not the frame, so a run repeats however fast it renders */
+void stressTick()
+{
+	if(simTime - stressWave >= stressEvery) {
+		spawnWave();
+		stressWave = simTime;
+	}
+	if(tickCount % stressShotTicks == 0) {
+		std::uniform_real_distribution<float> aim(-60, 60);
+		cannonAngle = snapAngle(aim(stressRng));
+		shootRequest = 1;
+	}
+}
+
+/* A report every second */
+void stressFrame(double now)
+{
+	stressFrames++;
+	if(now - stressReport >= 1) {
+		double secs = now - stressReport;
+		printf("stress: %.0f ticks/s, %.1f frames/s, %d bricks, %.1f MB resident\n",
+				stressTicks/secs, stressFrames/secs, (int)(brickx.size() - brickHead), residentMemory()/1048576.0);
+		stressTicks = 0; stressFrames = 0; stressReport = now;
+	}
+}
+
+/* Top the sparks back up to sparkBench before the frame runs */
+void sparkBenchFrame()
+{
+	int missing = sparkBench - particles->live();
+	if(missing > 0)
+		particles->emit(0, 0, missing, 3.0f, sparkFrames % 3);
+	sparkLive += particles->live();
+	sparkFrames++;
+	double now = wallClock();
+	if(now - sparkReport >= 1) {
+		// the first call only starts the clock
+		if(sparkReport > 0)
+			printf("sparks: %.0f live, %.2f ms/frame, %.1f frames/s\n", sparkLive/sparkFrames,
+					1000*(now - sparkReport)/sparkFrames, sparkFrames/(now - sparkReport));
+		sparkFrames = 0; sparkLive = 0; sparkReport = now;
+	}
+}
+
+/* Advance the game by exactly one simStep, from clock time start. Input and shots
+ * are resolved at the start of the tick, so the same events give the same game. */
+void simulate(double start)
+{
+	TRACE_ZONE("simulate");
+	tickTime = start;
+	savePrevState();
+	applyInput(start);
+	if(botMode) {
+		botControl();
+		// the bot decides inside the tick, so its shots only time tick to photon
+		if(latency && shootRequest)
+			latency->tickApplied(tickCount, latencyShot);
+	}
+	if(stressMode)
+		stressTick();
+	if(shootRequest) {
+		shootRequest = 0;
+		shootLaser();
+	}
+	makeChanges();
+	// the level's schedule steps the fall rate, N and M still adjust it in between
+	while(level && nextFall < (int)level->fallCount && simTime >= levelFalls(level)[nextFall].time)
+		setFallRate(levelFalls(level)[nextFall++].rate);
+	lastDrop = fallStep(fallRate);
+
+	simTime += simStep;
+	// bricks are where the fall line puts them, only the front of the queue is looked at
+	if(fallenAt(simTime) >= rebaseDistance)
+		rebaseBricks();
+	landBricks();
+	stressTicks++;
+	tickCount++;
+	if ((simTime - newRec_time) >= spawnInterval(fallRate) ) {
+		spawnBrick();
+		newRec_time = simTime;
+	}
+}
+
+void reportJobStats()
+{
+	static vector<WorkerStats> stats;
+	double seconds;
+	jobs->stats(stats, seconds);
+	printf("jobs:");
+	for(size_t i=0;i<stats.size();i++)
+		printf(" worker %d %.0f%% (%ld jobs, %ld steals)", (int)i, 100*stats[i].busy/seconds, stats[i].jobs, stats[i].steals);
+	printf("\n");
+	jobs->resetStats();
+}
+
 int main (int argc, char** argv)
 {
 	nlines = 0;
 	srand ( time(NULL) );
-	int count_rectangles = 0;
-	int objSelect = -1;
-	GLFWwindow* window = initGLFW(width, height);
+	for(int i=1;i<argc;i++)
+		if(string(argv[i]) == "--bot")
+			botMode = 1;
+		else if(string(argv[i]) == "--jobstats")
+			jobStats = 1;
+		else if(string(argv[i]) == "--stress" && i+1 < argc) {
+			stressMode = 1;
+			stressBricks = atoi(argv[++i]);
+		}
+		else if(string(argv[i]) == "--pattern" && i+1 < argc)
+			stressPattern = argv[++i];
+		else if(string(argv[i]) == "--wave-every" && i+1 < argc)
+			stressEvery = atof(argv[++i]);
+		else if(string(argv[i]) == "--headless") {
+			headless = 1;
+			if(i+1 < argc && isdigit(argv[i+1][0]))
+				headlessFrames = atoi(argv[++i]);
+		}
+		else if(string(argv[i]) == "--load" && i+1 < argc)
+			loadPath = argv[++i];
+		else if(string(argv[i]) == "--save" && i+1 < argc)
+			savePath = argv[++i];
+		else if(string(argv[i]) == "--capture" && i+1 < argc)
+			capturePath = argv[++i];
+		else if(string(argv[i]) == "--pace" && i+1 < argc) {
+			string mode = argv[++i];
+			paceSet = 1;
+			if(mode == "vsync")
+				paceMode = paceVsync;
+			else if(mode == "uncapped")
+				paceMode = paceUncapped;
+			else if(mode == "late")
+				paceMode = paceLate;
+			else if(atof(mode.c_str()) > 0) {
+				paceMode = paceCap;
+				paceFps = atof(mode.c_str());
+			}
+			else {
+				printf("--pace takes vsync, uncapped, late or frames per second\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if(string(argv[i]) == "--tournament" && i+1 < argc)
+			tournamentGames = atoi(argv[++i]);
+		else if(string(argv[i]) == "--level" && i+1 < argc)
+			levelPath = argv[++i];
+		else if(string(argv[i]) == "--latency")
+			latencyMode = 1;
+		else if(string(argv[i]) == "--sparks" && i+1 < argc)
+			sparksPerBurst = atoi(argv[++i]);
+		else if(string(argv[i]) == "--spark-bench" && i+1 < argc)
+			sparkBench = min(atoi(argv[++i]), maxParticles);
+		else if(string(argv[i]) == "--trace" && i+1 < argc)
+			tracePath = argv[++i];
+		else if(string(argv[i]) == "--alloc-check") {
+			allocCheck = 1;
+			if(i+1 < argc && isdigit(argv[i+1][0]))
+				allocWarmup = atoi(argv[++i]);
+		}
+		else if(string(argv[i]) == "--gl-check") {
+			glCheck = 1;
+			if(i+1 < argc && isdigit(argv[i+1][0]))
+				glWarmup = max(1, atoi(argv[++i]));
+		}
+		else if(string(argv[i]) == "--gl-stats")
+			glStats = 1;
+		else if(string(argv[i]) == "--min-score" && i+1 < argc) {
+			minScoreCheck = 1;
+			minScore = atoi(argv[++i]);
+		}
+	if(allocCheck && !allocCheckEnabled()) {
+		printf("--alloc-check needs a build with ALLOC_CHECK, run make ALLOC_CHECK=1\n");
+		exit(EXIT_FAILURE);
+	}
+	if(tracePath && !traceEnabled()) {
+		printf("--trace needs a build with TRACE, run make TRACE=1 (or TRACE=2 for find_mirror too)\n");
+		exit(EXIT_FAILURE);
+	}
+	if(tracePath)
+		traceStart(tracePath);
+	// stress and headless runs have to be reproducible, the bot is the input of a headless run
+	spawnRng = time(NULL) | 1;
+	if(stressMode || headless) {
+		srand(1);
+		spawnRng = 1;
+	}
+	if(headless)
+		botMode = 1;
+	jobs = new JobSystem();
+	particles = new ParticleSystem(*jobs);
+	if(botMode) {
+		botPool = new ThreadPool();
+		botAim = new AutoAim(*botPool);
+	}
+	if(levelPath && !(level = mapLevel(levelPath)))
+		exit(EXIT_FAILURE);
+	GLFWwindow* window = NULL;
+	if(headless) {
+		if(!initHeadless(width, height))
+			exit(EXIT_FAILURE);
+	}
+	else
+		window = initGLFW(width, height);
 	initGL (window, width, height);
-	double newRec_time = glfwGetTime(), current_time,fallRec_time = glfwGetTime() ;
-	while (!glfwWindowShouldClose(window) && gameon) {
-		current_time = glfwGetTime();
+	if(capturePath && !capture.start(capturePath, width, height, 60, headless))
+		exit(EXIT_FAILURE);
+	if(latencyMode)
+		latency = new LatencyProbe(inputClock);
+	// a headless run has nothing to sync to and goes as fast as it can unless capped
+	if(headless && !paceSet)
+		paceMode = paceUncapped;
+	pacer.start(window, paceMode, paceFps);
+	if(tournamentGames > 0) {
+		tournament = new Tournament(tournamentGames, headless ? 1 : time(NULL));
+		runTournament(window);
+	}
+	savePrevState();
+	if(loadPath && !loadSnapshotFile(loadPath))
+		exit(EXIT_FAILURE);
+	double current_time, previous_time = gameClock(), accumulator = 0;
+	double runStart = wallClock();
+	while ((headless ? headlessFrame < headlessFrames : !glfwWindowShouldClose(window)) && gameon) {
+		// late swap sleeps here, so the events are polled after it
+		pacer.beginFrame();
+		// the whole frame, the pacer's wait before it is the gap between two of these
+		TRACE_ZONE("frame");
+		if(!headless) {
+			TRACE_ZONE("poll");
+			glfwPollEvents();
+		}
+		frameArena.reset();
+		long newBefore = allocNewCount(), mallocBefore = allocMallocCount();
+		if(headless)
+			headlessFrame++;
+		current_time = gameClock();
+		double frame_time = current_time - previous_time;
+		previous_time = current_time;
+		// don't try to catch up on huge stalls (window drags, breakpoints)
+		if (frame_time > 0.25)
+			frame_time = 0.25;
+		accumulator += frame_time;
 		canshoot = minf((float)(current_time - lastShoot),1.0f);
 		createCharge(canshoot);
-		if ((current_time - fallRec_time) >= 0.01) {
-				pushDown();
-				fallRec_time = current_time ;
+		frameClock = current_time;
+		if(snapshotRequest == 1)
+			saveSnapshotFile(snapshotPath);
+		else if(snapshotRequest == 2)
+			loadSnapshotFile(snapshotPath);
+		snapshotRequest = 0;
+		if(stressMode)
+			stressFrame(current_time);
+		if(sparkBench)
+			sparkBenchFrame();
+		reshapeWindow (window, width, height);
+
+		// zero, one or several steps depending on how long the last frame took,
+		// the game has caught up to frameClock - accumulator
+		Job *sim = jobs->add([&] {
+			while (accumulator >= simStep) {
+				simulate(frameClock - accumulator);
+				accumulator -= simStep;
+			}
+		}, "simulate");
+		Job *sparks = jobs->add([&] { particleCount = particles->update((float)frame_time, &particleData[0]); }, "particles");
+		jobs->depend(sparks, sim);
+		jobs->run();
+
+		// GL calls stay on this thread
+		frameCount++;
+		if(latency)
+			latency->frameDrawn(frameCount);
+		double drawStart = wallClock();
+		draw(count_rectangles, (float)(accumulator/simStep));
+		if(headless) {
+			finishHeadlessFrame();
+			double spent = wallClock() - drawStart;
+			drawSeconds += spent;
+			drawWorst = max(drawWorst, spent);
 		}
-		double tmpx,tmpy;
-		float mouse_x,mouse_y;
-		if(mouse_press==1)
-		{
-			// printf("press detected\n");
-			glfwGetCursorPos(window,&tmpx,&tmpy);
-			// printf("tmox and tmpy %f %f\n",tmpx,tmpy);
-			mouse_x = ((float)tmpx - (float)width/2.0f )*8.0f/(float)width;
-			mouse_y = ((float)height/2.0f - (float)tmpy)*8.0f/(float)height;
-			// printf("Cursor at %f %f\n",mouse_x,mouse_y);
-			if(working==0){
-				objSelect = findObject(mouse_x,mouse_y);
-				// printf("Selected the following obj : %d\n",objSelect);
-				working = 1;
+		capture.grab(current_time);
+		if(jobStats && current_time - jobReport >= 1) {
+			reportJobStats();
+			jobReport = current_time;
+		}
+		pacer.beforeSwap();
+		if(!headless) {
+			TRACE_ZONE("swap");
+			glfwSwapBuffers(window);
+		}
+		pacer.afterSwap();
+		if(latency)
+			latency->frameSwapped();
+		if(allocCheck && ++allocFrame > allocWarmup) {
+			long news = allocNewCount() - newBefore;
+			if(news > 0) {
+				// malloc also counts the GL driver, so only operator new fails the check
+				printf("alloc-check: frame %ld made %ld operator new and %ld malloc calls\n",
+						allocFrame, news, allocMallocCount() - mallocBefore);
+				allocBadFrames++;
 			}
-			else
-				moveObject(objSelect,mouse_x,mouse_y);
 		}
-		makeChanges();
-		reshapeWindow (window, width, height);
-		draw(count_rectangles);
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-		if ((current_time - newRec_time) >= 0.02/fallRate ) { // atleast 0.5s elapsed since last frame
-			createRectangle (count_rectangles%100,rand()%2);
-			float xshift = ((float)(400 - (rand() % 700)))/100;
-			float yshift = 3.9;
-			rect.insert(make_pair(make_pair(xshift,yshift),count_rectangles%100));
-			count_rectangles++;
-			newRec_time = current_time;
+		if(glCheck && ++glCheckFrame >= glWarmup)
+			checkGLResources();
+	}
+	if(allocCheck) {
+		printf("alloc-check: %ld of %ld frames allocated after %d warm-up frames\n",
+				allocBadFrames, allocFrame > allocWarmup ? allocFrame - allocWarmup : 0, allocWarmup);
+		if(allocBadFrames > 0) {
+			closeGL();
+			exit(EXIT_FAILURE);
 		}
 	}
+	if(glCheck) {
+		const GLResourceCounts &gl = glResourceCounts();
+		printf("gl-check: %ld of %ld frames added GL objects after %d warm-up frames, live:",
+				glBadFrames, glCheckFrame > glWarmup ? glCheckFrame - glWarmup : 0, glWarmup);
+		for(int k=0;k<glResourceKinds;k++)
+			printf(" %ld %s", gl.live[k], glResourceName(k));
+		printf("\n");
+		if(glBadFrames > 0) {
+			closeGL();
+			exit(EXIT_FAILURE);
+		}
+	}
+	if(savePath)
+		saveSnapshotFile(savePath);
+	if(latency)
+		latency->report();
+	pacer.report();
+	if(tracePath)
+		traceWrite();
+	if(capture.active()) {
+		double seconds = wallClock() - runStart;
+		long frames = capture.frames();
+		capture.stop();
+		printf("capture: %.3f ms/frame on the render thread, %.1f%% of the frame time\n",
+				1000*capture.seconds()/max(frames, 1L), 100*capture.seconds()/seconds);
+	}
+	if(headless) {
+		double seconds = wallClock() - runStart;
+		printf("headless: %ld frames in %.2f s, %.1f frames/s\n", headlessFrame, seconds, headlessFrame/seconds);
+		printf("headless: draw %.3f ms/frame average, %.3f ms worst, %.1f draws/s\n",
+				1000*drawSeconds/headlessFrame, 1000*drawWorst, headlessFrame/drawSeconds);
+		printf("headless: last frame checksum %08x\n", headlessChecksum());
+		printf("headless: score %d, %d red and %d green caught, %d black and %d wrong shots\n",
+				score, collected[0], collected[1], blackhits, wronghits);
+		closeGL();
+		if(minScoreCheck && score < minScore) {
+			printf("min-score: %d is below %d\n", score, minScore);
+			exit(EXIT_FAILURE);
+		}
+		exit(EXIT_SUCCESS);
+	}
 	printf("******************GAME OVER**************************\n");
 	printf("Final Score : %d\nTotal Red Bricks collected : %d\nTotal Green Bricks collected : %d\nNo. of shots at black bricks : %d\nNo. of miss targets : %d\n",score,collected[0],collected[1],blackhits,wronghits);
-	while(glfwGetTime()-newRec_time < 2);
-	glfwTerminate();
+	// the score stays up for two seconds, the window keeps answering meanwhile
+	double end_time = glfwGetTime();
+	for(double left = 2; left > 0; left = 2 - (glfwGetTime() - end_time))
+		glfwWaitEventsTimeout(left);
+	closeGL();
 	exit(EXIT_SUCCESS);
 	return 0;
 }
@@ -0,0 +1,162 @@
+#include "capture.h"
+#include "wallClock.h"
+
+#include <math.h>
+#include <string.h>
+
+bool FrameCapture::start(const char *path, int w, int h, int rate, bool waitForEncoder)
+{
+	fps = rate;
+	// 4:2:0 needs even sizes
+	width = w & ~1; height = h & ~1;
+	file = fopen(path, "wb");
+	if(!file) {
+		fprintf(stderr, "capture: can't create %s\n", path);
+		return false;
+	}
+	fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+
+	for(int i=0;i<capturePBOs;i++) {
+		pbo[i] = GLBuffer::create();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+		glBufferUpload(GL_PIXEL_PACK_BUFFER, 4*width*height, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	freeSlots.clear(); queued.clear();
+	queued.reserve(captureSlots);
+	for(int i=0;i<captureSlots;i++) {
+		slots[i].resize(4*width*height);
+		freeSlots.push_back(i);
+	}
+	yuv.resize(width*height*3/2);
+	frame = dropped = written = skipped = shown = 0;
+	renderSeconds = 0;
+	wait = waitForEncoder;
+	stopping = false;
+	encoder = std::thread(&FrameCapture::encoderLoop, this);
+	printf("capture: %dx%d at %d fps to %s\n", width, height, fps, path);
+	return true;
+}
+
+void FrameCapture::grab(double t)
+{
+	if(!file)
+		return;
+	// video frames up to and including t, a little slack so a frame on the dot counts
+	if(frame == 0 && shown == 0)
+		first = t;
+	long due = (long)floor((t - first)*fps + 1e-6) + 1;
+	if(due <= shown) {
+		skipped++;
+		return;
+	}
+	double begin = wallClock();
+	// with three buffers the one read two frames ago is the next to reuse after this one
+	if(frame >= capturePBOs - 1)
+		collect((frame + 1) % capturePBOs);
+	pboRepeat[frame % capturePBOs] = due - shown;
+	shown = due;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[frame % capturePBOs]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	frame++;
+	renderSeconds += wallClock() - begin;
+}
+
+/* Copy a finished readback to a free slot and hand it to the encoder */
+void FrameCapture::collect(int index)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[index]);
+	const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 4*width*height, GL_MAP_READ_BIT);
+	if(pixels) {
+		int slot = -1;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			if(wait)
+				drained.wait(guard, [this] { return !freeSlots.empty(); });
+			if(!freeSlots.empty()) {
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+		}
+		if(slot < 0)
+			dropped++;
+		else {
+			memcpy(&slots[slot][0], pixels, 4*width*height);
+			slotRepeat[slot] = pboRepeat[index];
+			std::lock_guard<std::mutex> guard(lock);
+			queued.push_back(slot);
+			wake.notify_one();
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::stop()
+{
+	if(!file)
+		return;
+	// the last two frames are still in their buffers
+	for(long f = frame >= capturePBOs - 1 ? frame - (capturePBOs - 1) : 0; f < frame; f++)
+		collect(f % capturePBOs);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	encoder.join();
+	for(int i=0;i<capturePBOs;i++)
+		pbo[i].reset();
+	fclose(file);
+	file = NULL;
+	printf("capture: %ld frames written at %d fps, %ld dropped, %ld skipped\n", written, fps, dropped, skipped);
+}
+
+void FrameCapture::encoderLoop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while(true) {
+		wake.wait(guard, [this] { return stopping || !queued.empty(); });
+		if(queued.empty())
+			return;
+		int slot = queued.front();
+		queued.erase(queued.begin());
+		guard.unlock();
+		writeFrame(&slots[slot][0], slotRepeat[slot]);
+		guard.lock();
+		freeSlots.push_back(slot);
+		drained.notify_one();
+	}
+}
+
+/* RGBA rows come bottom up from GL, Y4M wants planar YUV 4:2:0 top down (full range BT.601) */
+void FrameCapture::writeFrame(const unsigned char *rgba, int repeat)
+{
+	unsigned char *py = &yuv[0], *pu = py + width*height, *pv = pu + width*height/4;
+	for(int y=0;y<height;y++) {
+		const unsigned char *row = rgba + 4*width*(height-1-y);
+		for(int x=0;x<width;x++) {
+			const unsigned char *p = row + 4*x;
+			py[y*width + x] = (unsigned char)((77*p[0] + 150*p[1] + 29*p[2]) >> 8);
+		}
+	}
+	for(int y=0;y<height;y+=2) {
+		const unsigned char *row0 = rgba + 4*width*(height-1-y), *row1 = row0 - 4*width;
+		for(int x=0;x<width;x+=2) {
+			int r = row0[4*x] + row0[4*x+4] + row1[4*x] + row1[4*x+4];
+			int g = row0[4*x+1] + row0[4*x+5] + row1[4*x+1] + row1[4*x+5];
+			int b = row0[4*x+2] + row0[4*x+6] + row1[4*x+2] + row1[4*x+6];
+			// sums of four pixels, hence >> 10 instead of >> 8
+			pu[(y/2)*(width/2) + x/2] = (unsigned char)(128 + ((-43*r - 85*g + 128*b) >> 10));
+			pv[(y/2)*(width/2) + x/2] = (unsigned char)(128 + ((128*r - 107*g - 21*b) >> 10));
+		}
+	}
+	for(int i=0;i<repeat;i++) {
+		fputs("FRAME\n", file);
+		fwrite(&yuv[0], 1, yuv.size(), file);
+		written++;
+	}
+}
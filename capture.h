@@ -0,0 +1,73 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "glResources.h"
+
+/* Records the frames drawn into a Y4M video (--capture <file>).
+ * grab() queues an asynchronous glReadPixels into a ring of pixel buffer
+ * objects and maps the one read two frames earlier, which the GPU has long
+ * finished, so the render thread never waits for the readback. The pixels
+ * are copied into a slot and an encoder thread converts them to YUV 4:2:0
+ * and writes them out. If the encoder falls behind, frames are dropped
+ * rather than stalling the game, unless waiting was asked for (headless runs,
+ * where nobody watches in real time).
+ * The video has a fixed rate whatever the pacing, frames are placed on it by the
+ * game clock: one that no video frame came due for is not read back, and one shown
+ * for several video frames is written that many times. */
+
+const int capturePBOs = 3;
+const int captureSlots = 8;
+
+class FrameCapture {
+public:
+	FrameCapture() : file(NULL), frame(0), dropped(0), written(0), skipped(0), shown(0), wait(false), renderSeconds(0), stopping(false) {}
+	~FrameCapture() { stop(); }
+
+	/* Open path and write the stream header, false if the file can't be created.
+	 * With wait set, a full queue blocks instead of dropping the frame. */
+	bool start(const char *path, int width, int height, int fps, bool wait = false);
+	/* Call after drawing a frame, before swapping buffers, t is the game clock it shows */
+	void grab(double t);
+	/* Read the frames still in flight, wait for the encoder and close the file */
+	void stop();
+
+	bool active() const { return file != NULL; }
+	long frames() const { return frame; }
+	long framesDropped() const { return dropped; }
+	/* Seconds the render thread spent in grab() */
+	double seconds() const { return renderSeconds; }
+
+private:
+	void collect(int pbo);
+	void encoderLoop();
+	void writeFrame(const unsigned char *rgba, int repeat);
+
+	FILE *file;
+	int width, height, fps;
+	GLBuffer pbo[capturePBOs];
+	int pboRepeat[capturePBOs], slotRepeat[captureSlots];   // video frames each one is written for
+	long frame, dropped, written, skipped;
+	double first;            // game clock of the first frame
+	long shown;              // video frames filled so far
+	bool wait;
+	double renderSeconds;
+
+	// slots are either free or queued for the encoder, both lists are fixed size
+	std::vector<unsigned char> slots[captureSlots];
+	std::vector<int> freeSlots, queued;
+	std::vector<unsigned char> yuv;
+	std::mutex lock;
+	std::condition_variable wake, drained;
+	std::thread encoder;
+	bool stopping;
+};
+
+#endif
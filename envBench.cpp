@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "brickEnv.h"
+#include "gameLogic.h"
+#include "perfCounters.h"
+#include "wallClock.h"
+
+const int shotsPerEnv = 64;      // laser benchmark shots at every environment's bricks
+
+/* Steps a batch of headless games with random actions and reports the throughput, then
+ * fires random shots through traceLaser at the bricks the games were left with.
+ * Both benchmarks print hardware counters per item where perf_event_open allows.
+ * Everything here is BrickEnvBatch's per-environment brick arrays. The game's own
+ * landing queue (brickx, brickBase, landBricks) lives in the GL binary and isn't
+ * measured, so this doesn't tell you anything about changes to that one.
+ * usage: envbench [environments] [threads] [steps] */
+int main (int argc, char** argv)
+{
+	int numEnvs = argc > 1 ? atoi(argv[1]) : 4096;
+	int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+	int steps = argc > 3 ? atoi(argv[3]) : 1000;
+
+	// before the batch, so its pool threads inherit the counters
+	PerfCounters counters;
+	BrickEnvBatch envs(numEnvs, numThreads);
+	std::vector<EnvAction> actions(numEnvs);
+	envs.reset_all();
+
+	uint32_t r = 12345;
+	double total = 0;
+	long episodes = 0;
+	double start = wallClock();
+	counters.start();
+	for(int s=0;s<steps;s++) {
+		for(int e=0;e<numEnvs;e++) {
+			r = r*1664525u + 1013904223u;
+			actions[e].cannonShift = (int)(r >> 30) - 1;
+			actions[e].cannonRot = (int)((r >> 28) & 3) - 1;
+			actions[e].red = (int)((r >> 26) & 3) - 1;
+			actions[e].green = (int)((r >> 24) & 3) - 1;
+			actions[e].shoot = (r >> 16) & 1;
+		}
+		EnvStepResult res = envs.step_batch(&actions[0]);
+		for(int e=0;e<numEnvs;e++) {
+			total += res.rewards[e];
+			episodes += res.dones[e];
+		}
+	}
+	PerfSample stepSample = counters.stop();
+	double stepSecs = wallClock() - start;
+	printf("%d environments on %d threads, %d steps in %.3f s\n", numEnvs, envs.threads(), steps, stepSecs);
+	printf("environment steps/s : %.0f\n", (double)numEnvs*steps/stepSecs);
+	printf("total reward : %.0f over %ld finished episodes\n", total, episodes);
+
+	// the laser and its brick scan as the game's shootLaser does them, on this thread only
+	long shots = 0, hits = 0;
+	start = wallClock();
+	counters.start();
+	for(int e=0;e<numEnvs;e++) {
+		EnvView v = envs.view(e);
+		auto scanBricks = [&](float xstart, float ystart, float slope, int xinc, float *finalx, float *finaly) {
+			int found = 0;
+			for(int i=0;i<v.numBricks;i++) {
+				float x1 = v.brickx[i], y1 = v.bricky[i];
+				if(brickOnRay(x1,y1,xstart,ystart,slope) && updatable(x1,*finalx,xstart,xinc)) {
+					*finalx = x1;
+					*finaly = slope*(x1-xstart) + ystart;
+					found = 1;
+				}
+			}
+			return found;
+		};
+		auto noSegment = [](float, float, float, float) {};
+		for(int k=0;k<shotsPerEnv;k++) {
+			r = r*1664525u + 1013904223u;
+			float shift = -3.4f + (r >> 8)*(7.4f/16777216.0f);
+			r = r*1664525u + 1013904223u;
+			float angle = snapAngle((r >> 8)*(180.0f/16777216.0f) - 90);
+			hits += traceLaser(shift, angle, v.mirrorx, v.mirrory, v.mirrorAng, numMirrors, scanBricks, noSegment);
+			shots++;
+		}
+	}
+	PerfSample laserSample = counters.stop();
+	double laserSecs = wallClock() - start;
+	printf("laser shots : %ld, %ld hit a brick\n", shots, hits);
+
+	PerfCounters::print("step", stepSample, stepSecs, (double)numEnvs*steps, "env step");
+	PerfCounters::print("laser", laserSample, laserSecs, shots, "shot");
+	return 0;
+}
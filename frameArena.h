@@ -0,0 +1,93 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdlib.h>
+
+/* Bump-pointer allocator for data that only lives until the end of the frame.
+ * alloc() is a single atomic add and is safe from any job. Nothing is freed on
+ * its own, reset() at the start of a frame releases everything at once. If a
+ * frame runs out of room the rest comes from malloc, and the next reset()
+ * grows the arena so later frames fit again. */
+class FrameArena {
+public:
+	explicit FrameArena(size_t capacity = 1 << 20)
+		: base(NULL), capacity(0), used(0), overflow(NULL), highWater(0)
+	{
+		grow(capacity);
+	}
+
+	~FrameArena()
+	{
+		releaseOverflow();
+		free(base);
+	}
+
+	void *alloc(size_t size, size_t align = 16)
+	{
+		size = (size + align - 1) & ~(align - 1);
+		size_t offset = used.fetch_add(size + align);
+		size_t start = (offset + align - 1) & ~(align - 1);
+		if(start + size <= capacity)
+			return base + start;
+		// out of room, keep going and remember to grow at the next reset
+		Overflow *block = (Overflow*)malloc(sizeof(Overflow) + size + align);
+		Overflow *head = overflow.load();
+		do {
+			block->next = head;
+		} while(!overflow.compare_exchange_weak(head, block));
+		size_t p = ((size_t)(block + 1) + align - 1) & ~(align - 1);
+		return (void*)p;
+	}
+
+	template <class T>
+	T *allocArray(size_t n)
+	{
+		return (T*)alloc(n*sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+	}
+
+	void reset()
+	{
+		size_t wanted = used.load();
+		if(wanted > highWater)
+			highWater = wanted;
+		releaseOverflow();
+		if(highWater > capacity)
+			grow(highWater*2);
+		used.store(0);
+	}
+
+	size_t size() const { return capacity; }
+
+private:
+	struct Overflow {
+		Overflow *next;
+		size_t pad;
+	};
+
+	void grow(size_t newCapacity)
+	{
+		free(base);
+		base = (char*)malloc(newCapacity);
+		capacity = newCapacity;
+	}
+
+	void releaseOverflow()
+	{
+		Overflow *block = overflow.exchange(NULL);
+		while(block) {
+			Overflow *next = block->next;
+			free(block);
+			block = next;
+		}
+	}
+
+	char *base;
+	size_t capacity;
+	std::atomic<size_t> used;
+	std::atomic<Overflow*> overflow;
+	size_t highWater;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "framePacer.h"
+#include "wallClock.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+
+const double lateMargin = 0.001;          // late mode aims this far before the vblank
+const double minSpin = 0.0002, maxSpin = 0.002;
+
+static const char *modeName(PaceMode mode)
+{
+	switch(mode) {
+		case paceVsync: return "vsync";
+		case paceUncapped: return "uncapped";
+		case paceCap: return "cap";
+		case paceLate: return "late swap";
+	}
+	return "";
+}
+
+FramePacer::FramePacer()
+	: mode(paceVsync), period(0), deadline(0), frameStart(0), lastSwap(0),
+	workEstimate(0), spinMargin(0.001),
+	intervals(0), missed(0), sum(0), sumSquares(0), shortest(1e9), longest(0)
+{
+}
+
+void FramePacer::start(GLFWwindow *window, PaceMode m, double fps)
+{
+	mode = m;
+	if(!window && (mode == paceVsync || mode == paceLate))
+		mode = paceUncapped;
+	period = 0;
+	if(mode == paceCap)
+		period = 1/fps;
+	else if(mode == paceVsync || mode == paceLate) {
+		const GLFWvidmode *video = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		period = 1.0/(video && video->refreshRate > 0 ? video->refreshRate : 60);
+	}
+	if(window) {
+		int interval = mode == paceVsync || mode == paceLate ? 1 : 0;
+		// tear control: -1 waits for the vblank only when the frame is on time
+		if(mode == paceLate && (glfwExtensionSupported("GLX_EXT_swap_control_tear") ||
+					glfwExtensionSupported("WGL_EXT_swap_control_tear")))
+			interval = -1;
+		glfwSwapInterval(interval);
+	}
+	lastSwap = deadline = wallClock();
+	if(period > 0)
+		printf("pace: %s at %.1f frames/s\n", modeName(mode), 1/period);
+	else
+		printf("pace: %s\n", modeName(mode));
+}
+
+void FramePacer::waitUntil(double t)
+{
+	double now = wallClock();
+	while(t - now > spinMargin) {
+		double want = t - now - spinMargin;
+		std::this_thread::sleep_for(std::chrono::duration<double>(want));
+		double after = wallClock();
+		// the margin follows the worst recent oversleep, decaying slowly
+		double over = (after - now) - want;
+		spinMargin = fmax(minSpin, fmin(maxSpin, fmax(over*1.25, spinMargin*0.99)));
+		now = after;
+	}
+	while(wallClock() < t)
+		std::this_thread::yield();
+}
+
+void FramePacer::beginFrame()
+{
+	// vsync swaps return at the vblank, the next one is a period after the last
+	if(mode == paceLate && intervals > 0)
+		waitUntil(lastSwap + period - workEstimate - lateMargin);
+	frameStart = wallClock();
+}
+
+void FramePacer::beforeSwap()
+{
+	double now = wallClock();
+	if(mode == paceLate) {
+		// quick to grow after a slow frame, slow to shrink
+		double work = now - frameStart;
+		workEstimate = work > workEstimate ? work : workEstimate*0.95 + work*0.05;
+	}
+	if(mode == paceCap) {
+		deadline += period;
+		// more than a frame behind, don't rush to catch up
+		if(deadline < now - period)
+			deadline = now;
+		waitUntil(deadline);
+	}
+}
+
+void FramePacer::afterSwap()
+{
+	double now = wallClock();
+	double interval = now - lastSwap;
+	lastSwap = now;
+	intervals++;
+	sum += interval;
+	sumSquares += interval*interval;
+	if(interval < shortest)
+		shortest = interval;
+	if(interval > longest)
+		longest = interval;
+	if(period > 0 && interval > 1.5*period)
+		missed++;
+}
+
+void FramePacer::report() const
+{
+	if(intervals < 2)
+		return;
+	double mean = sum/intervals;
+	double deviation = sqrt(fmax(0, sumSquares/intervals - mean*mean));
+	printf("pace: %s, %ld frames, %.3f ms average, jitter %.3f ms (standard deviation), %.3f to %.3f ms\n",
+			modeName(mode), intervals, 1000*mean, 1000*deviation, 1000*shortest, 1000*longest);
+	if(period > 0)
+		printf("pace: target %.3f ms, %ld frames (%.1f%%) took more than 1.5 periods\n",
+				1000*period, missed, 100.0*missed/intervals);
+}
@@ -0,0 +1,47 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GLFW/glfw3.h>
+
+/* When frames start and get swapped, --pace.
+ *   vsync     swap interval 1, the driver blocks in the swap
+ *   uncapped  swap interval 0, as fast as the frame can be made, for benchmarking
+ *   cap       swap interval 0 and a fixed rate, each frame waits for its slot
+ *   late      vsync, but the frame starts as late as its measured cost allows so
+ *             input is read just before the swap deadline, and with tear control
+ *             a frame that misses it is shown late instead of a whole period later
+ * Waits sleep while the deadline is far and spin only the last stretch, as long as
+ * the scheduler has been seen to oversleep. Interval jitter is printed by report(). */
+
+enum PaceMode { paceVsync, paceUncapped, paceCap, paceLate };
+
+class FramePacer {
+public:
+	FramePacer();
+
+	/* window is NULL when headless, vsync and late then run uncapped */
+	void start(GLFWwindow *window, PaceMode mode, double fps);
+	/* Before the frame reads input and the clock */
+	void beginFrame();
+	/* Right before the swap */
+	void beforeSwap();
+	void afterSwap();
+	void report() const;
+
+private:
+	/* Sleeps until t on the steady clock, spinning the last spinMargin seconds */
+	void waitUntil(double t);
+
+	PaceMode mode;
+	double period;           // target seconds per frame, 0 uncapped
+	double deadline;         // cap: when the next swap is due
+	double frameStart, lastSwap;
+	double workEstimate;     // late: seconds from frame start to swap, kept on the high side
+	double spinMargin;       // how much the scheduler oversleeps, learned
+
+	// swap to swap intervals
+	long intervals, missed;
+	double sum, sumSquares, shortest, longest;
+};
+
+#endif
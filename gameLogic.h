@@ -0,0 +1,243 @@
+#ifndef GAME_LOGIC_H
+#define GAME_LOGIC_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "trace.h"
+#include "trigTables.h"
+
+/* Game rules that don't touch OpenGL, shared by the game and the headless environments */
+
+/* The simulation advances in fixed steps of simStep seconds, however fast we render */
+const double simStep = 1.0/240.0;
+/* Movement speeds were tuned per frame at 60 fps, scale them to one step */
+const float stepScale = 60.0*simStep;
+
+const float cannonSpeed = 0.02;   // cannonShift per 60 fps frame
+const float cannonTurn = 0.2;     // degrees per 60 fps frame
+const float bucketSpeed = 0.02;   // BucShift per 60 fps frame
+
+const float spawnY = 3.9;         // bricks appear here
+const float landY = -3.4;         // and are resolved against the buckets here
+const float brickHit = 0.20;      // vertical distance at which a laser hits a brick
+const float mirrorLength = 1.5;
+const int maxLaserSegments = 5;   // size of line[] in the game
+
+const int numMirrors = 3;
+const float mirrorStartX[numMirrors] = {-2, 2.5, -0.5};
+const float mirrorStartY[numMirrors] = {0, -2, -3};
+
+inline float checkRange(float val, float low, float high)
+{
+	if(val>high)
+		return high;
+	if(val<low)
+		return low;
+	return val;
+}
+
+/* Distance a brick falls in one step, bricks used to fall by fallRate every 0.01s */
+inline float fallStep(float fallRate)
+{
+	return fallRate*simStep/0.01;
+}
+
+/* Seconds between two spawns */
+inline double spawnInterval(float fallRate)
+{
+	return 0.02/fallRate;
+}
+
+/* Spawn x in [-3, 4], as it always was */
+inline float spawnX(int r)
+{
+	return ((float)(400 - (r % 700)))/100;
+}
+
+/* Spawn x in (xmin, xmax] in steps of 0.01, spawnXIn(r, -3, 4) is spawnX(r) */
+inline float spawnXIn(int r, float xmin, float xmax)
+{
+	int top = (int)lroundf(xmax*100), steps = (int)lroundf((xmax - xmin)*100);
+	return ((float)(top - (r % steps)))/100;
+}
+
+inline int inBucket(float xcord, float bucShift)
+{
+	if(xcord<0.5+bucShift && xcord>bucShift-0.5)
+		return 1;
+	return 0;
+}
+
+/* Points for shooting a brick, BlColour >= 1 counts as black */
+inline int shotPoints(int colour)
+{
+	if(colour>=1)
+		return 20;
+	return -10;
+}
+
+inline int updatable(float x1, float x2, float xstart, int x4)
+{
+	if(x4==1)
+		if(x1<xstart)
+			return 0;
+	if(x4==-1)
+		if(x1>xstart)
+			return 0;
+	if(std::abs(x1-xstart)<std::abs(x2-xstart))
+		return 1;
+	return 0;
+}
+
+/* Does the beam hit mirror i closer than (xbound, ybound), if so that becomes the new bound */
+inline int mirrorHit(int i, float *xbound, float *ybound, float xstart, float ystart, float slope, int xinc,
+		const float *mirrorx, const float *mirrory, const float *mirrorAng)
+{
+	int m = angleIndex(mirrorAng[i]);
+	float mirrorSlope = tanIndex(m);
+	float xinter = ( slope*xstart - mirrorSlope*mirrorx[i] - ystart + mirrory[i] ) / (slope - mirrorSlope);
+	float yinter = slope*(xinter - xstart) + ystart ;
+	if(updatable(xinter,*xbound,xstart,xinc))
+	{
+		if(xinter > mirrorx[i] && xinter < mirrorx[i]+mirrorLength*cosIndex(m) && yinter > mirrory[i] && yinter < mirrory[i] + mirrorLength*sinIndex(m))
+		{
+			*xbound = xinter;
+			*ybound = yinter;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+inline int find_mirror(float *xbound, float *ybound, float xstart, float ystart, float slope,int xinc,int premirr,
+		const float *mirrorx, const float *mirrory, const float *mirrorAng, int nmirrors)
+{
+	TRACE_ZONE_FINE("find_mirror");
+	int toret = 0 ;
+	for(int i=0;i<nmirrors;i++)
+		if(i!=premirr && mirrorHit(i,xbound,ybound,xstart,ystart,slope,xinc,mirrorx,mirrory,mirrorAng))
+			toret = i+1;
+	return toret;
+}
+
+/* Uniform grid over the mirrors of a level, see buildMirrorGrid. A cell lists every mirror
+ * its segment crosses, so a beam only tests the mirrors of the cells it crosses. */
+struct MirrorGrid {
+	int cols, rows;
+	float x0, y0, cellW, cellH;
+	const uint32_t *cellStart;      // cols*rows+1 offsets into cellMirrors
+	const uint32_t *cellMirrors;
+	int loose;                      // a mirror being dragged, its cells are stale so it is tested on its own, or -1
+};
+
+/* find_mirror through the grid. Cells are visited in the order the beam crosses them and
+ * the walk stops at the first cell that ends beyond a hit, nothing further on can be closer. */
+inline int find_mirror_grid(float *xbound, float *ybound, float xstart, float ystart, float slope,int xinc,int premirr,
+		const float *mirrorx, const float *mirrory, const float *mirrorAng, const MirrorGrid &grid)
+{
+	TRACE_ZONE_FINE("find_mirror");
+	int toret = 0;
+	if(grid.loose >= 0 && grid.loose != premirr && mirrorHit(grid.loose,xbound,ybound,xstart,ystart,slope,xinc,mirrorx,mirrory,mirrorAng))
+		toret = grid.loose+1;
+	// the beam is (xstart,ystart) + t*(xinc, xinc*slope) for t in [0, |xbound - xstart|]
+	double dy = xinc*(double)slope;
+	double gx0 = grid.x0, gx1 = grid.x0 + grid.cols*grid.cellW;
+	double gy0 = grid.y0, gy1 = grid.y0 + grid.rows*grid.cellH;
+	double tin = xinc > 0 ? gx0 - xstart : xstart - gx1;
+	double tout = xinc > 0 ? gx1 - xstart : xstart - gx0;
+	if(dy != 0) {
+		double ta = (gy0 - ystart)/dy, tb = (gy1 - ystart)/dy;
+		tin = std::max(tin, std::min(ta, tb));
+		tout = std::min(tout, std::max(ta, tb));
+	}
+	else if(ystart < gy0 || ystart > gy1)
+		return toret;
+	tin = std::max(tin, 0.0);
+	tout = std::min(tout, (double)std::abs(*xbound - xstart));
+	if(tin > tout)
+		return toret;
+
+	double px = xstart + xinc*tin, py = ystart + dy*tin;
+	int cx = std::min(std::max((int)((px - gx0)/grid.cellW), 0), grid.cols-1);
+	int cy = std::min(std::max((int)((py - gy0)/grid.cellH), 0), grid.rows-1);
+	int stepy = dy > 0 ? 1 : -1;
+	double nextx = tin + std::abs(gx0 + (cx + (xinc > 0))*grid.cellW - px);
+	double nexty = dy != 0 ? tin + std::abs(gy0 + (cy + (stepy > 0))*grid.cellH - py)/std::abs(dy) : HUGE_VAL;
+	double deltay = dy != 0 ? grid.cellH/std::abs(dy) : HUGE_VAL;
+
+	while(true) {
+		int cell = cy*grid.cols + cx;
+		for(uint32_t k=grid.cellStart[cell];k<grid.cellStart[cell+1];k++) {
+			int i = grid.cellMirrors[k];
+			if(i!=premirr && i!=grid.loose && mirrorHit(i,xbound,ybound,xstart,ystart,slope,xinc,mirrorx,mirrory,mirrorAng))
+				toret = i+1;
+		}
+		double leave = std::min(nextx, nexty);
+		if((toret && std::abs(*xbound - xstart) <= leave) || leave >= tout)
+			return toret;
+		if(nextx < nexty) {
+			cx += xinc;
+			nextx += grid.cellW;
+		}
+		else {
+			cy += stepy;
+			nexty += deltay;
+		}
+		if(cx < 0 || cx >= grid.cols || cy < 0 || cy >= grid.rows)
+			return toret;
+	}
+}
+
+inline void find_boundary(float *xbound, float *ybound, float xstart, float ystart, float slope,int xinc)
+{
+	*xbound = 4*xinc;
+	*ybound = (*xbound - xstart)*slope + ystart ;
+	return;
+}
+
+/* Does the laser y = slope*(x-xstart)+ystart pass through the brick at (x1,y1) */
+inline int brickOnRay(float x1, float y1, float xstart, float ystart, float slope)
+{
+	float tmp = slope*(x1-xstart) + ystart ;
+	return std::abs(y1-tmp)<=brickHit;
+}
+
+/* Follow a laser shot from the cannon, reflecting off mirrors.
+ * Mirrors are tested through grid when there is one, all of them otherwise.
+ * scanBricks(xstart,ystart,slope,xinc,&finalx,&finaly) moves the end point to the nearest
+ * brick on the segment and returns 1 if it found one. onSegment(x1,y1,x2,y2) is called for
+ * every segment of the beam. Returns 1 if the beam stopped on a brick.
+ * Angles go through the trig tables, there are no trig calls on this path. */
+template <class ScanBricks, class OnSegment>
+int traceLaser(float cannonShift, float cannonAngle, const float *mirrorx, const float *mirrory, const float *mirrorAng, int nmirrors,
+		ScanBricks scanBricks, OnSegment onSegment, const MirrorGrid *grid = NULL)
+{
+	int angle = angleIndex(cannonAngle);
+	float xstart = -4 + 0.5*cosIndex(angle);
+	float ystart = cannonShift + 0.5*sinIndex(angle);
+	int xinc = 1, premirr = -1;
+	for(int seg=0; seg<maxLaserSegments; seg++)
+	{
+		float finalx=0.0,finaly=0.0 ;
+		float slope = tanIndex(angle);
+		find_boundary(&finalx,&finaly,xstart,ystart,slope,xinc);
+		int ifmirror = grid ? find_mirror_grid(&finalx,&finaly,xstart,ystart,slope,xinc,premirr,mirrorx,mirrory,mirrorAng,*grid) :
+			find_mirror(&finalx,&finaly,xstart,ystart,slope,xinc,premirr,mirrorx,mirrory,mirrorAng,nmirrors);
+		int hit = scanBricks(xstart,ystart,slope,xinc,&finalx,&finaly);
+		onSegment(xstart,ystart,finalx,finaly);
+		if(hit)
+			return 1;
+		if(ifmirror == 0)
+			return 0;
+		angle = reflectIndex(angleIndex(mirrorAng[ifmirror-1]), angle);
+		xinc = cosIndex(angle) >= 0 ? 1 : -1;
+		xstart = finalx; ystart = finaly;
+		premirr = ifmirror-1;
+	}
+	return 0;
+}
+
+#endif
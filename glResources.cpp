@@ -0,0 +1,72 @@
+#include "glResources.h"
+
+/* GL objects are only made and used on the render thread, so plain counters do */
+static GLResourceCounts counts;
+static bool detached = false;
+
+const GLResourceCounts &glResourceCounts()
+{
+	return counts;
+}
+
+const char *glResourceName(int kind)
+{
+	static const char *names[glResourceKinds] = {"VAO", "BUF", "SHADER", "PROGRAM", "TEXTURE"};
+	return names[kind];
+}
+
+GLuint glResourceCreate(GLResourceKind kind, GLenum shaderType)
+{
+	GLuint name = 0;
+	switch(kind) {
+		case glVertexArrays: glGenVertexArrays(1, &name); break;
+		case glBuffers: glGenBuffers(1, &name); break;
+		case glShaders: name = glCreateShader(shaderType); break;
+		case glPrograms: name = glCreateProgram(); break;
+		case glTextures: glGenTextures(1, &name); break;
+		default: break;
+	}
+	if(name) {
+		counts.live[kind]++;
+		counts.created[kind]++;
+	}
+	return name;
+}
+
+void glResourceDelete(GLResourceKind kind, GLuint name)
+{
+	counts.live[kind]--;
+	if(detached)
+		return;
+	switch(kind) {
+		case glVertexArrays: glDeleteVertexArrays(1, &name); break;
+		case glBuffers: glDeleteBuffers(1, &name); break;
+		case glShaders: glDeleteShader(name); break;
+		case glPrograms: glDeleteProgram(name); break;
+		case glTextures: glDeleteTextures(1, &name); break;
+		default: break;
+	}
+}
+
+void glResourcesDetach()
+{
+	detached = true;
+}
+
+void glBufferUpload(GLenum target, size_t bytes, const void *data, GLenum usage)
+{
+	glBufferData(target, bytes, data, usage);
+	if(data)
+		counts.uploaded[glBuffers] += bytes;
+}
+
+void glBufferUpdate(GLenum target, size_t offset, size_t bytes, const void *data)
+{
+	glBufferSubData(target, offset, bytes, data);
+	counts.uploaded[glBuffers] += bytes;
+}
+
+void glCountUpload(GLResourceKind kind, size_t bytes)
+{
+	counts.uploaded[kind] += bytes;
+}
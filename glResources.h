@@ -0,0 +1,78 @@
+#ifndef GL_RESOURCES_H
+#define GL_RESOURCES_H
+
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+/* Owning handles for GL objects. A GLObject deletes its name when it goes away and
+ * can only be moved, never copied, so every object has exactly one owner. It converts
+ * to its GLuint, so it can be passed to GL calls as it is.
+ * Every create and delete goes through a registry that keeps live counts per kind,
+ * together with the bytes uploaded into buffers and textures, for the HUD and --gl-check. */
+
+enum GLResourceKind { glVertexArrays, glBuffers, glShaders, glPrograms, glTextures, glResourceKinds };
+
+struct GLResourceCounts {
+	long live[glResourceKinds];
+	long created[glResourceKinds];
+	double uploaded[glResourceKinds];    // bytes
+};
+
+const GLResourceCounts &glResourceCounts();
+const char *glResourceName(int kind);
+
+GLuint glResourceCreate(GLResourceKind kind, GLenum shaderType);
+void glResourceDelete(GLResourceKind kind, GLuint name);
+/* The context is about to go, objects that go away later only leave the counts */
+void glResourcesDetach();
+
+/* glBufferData and glBufferSubData on the bound buffer, counted. NULL data only allocates */
+void glBufferUpload(GLenum target, size_t bytes, const void *data, GLenum usage);
+void glBufferUpdate(GLenum target, size_t offset, size_t bytes, const void *data);
+void glCountUpload(GLResourceKind kind, size_t bytes);
+
+template <GLResourceKind Kind>
+class GLObject {
+public:
+	GLObject() : name(0) {}
+	~GLObject() { reset(); }
+	GLObject(GLObject &&o) : name(o.name) { o.name = 0; }
+	GLObject &operator=(GLObject &&o)
+	{
+		if(this != &o) {
+			reset();
+			name = o.name;
+			o.name = 0;
+		}
+		return *this;
+	}
+	GLObject(const GLObject &) = delete;
+	GLObject &operator=(const GLObject &) = delete;
+
+	/* shaderType is only for shaders, GL_VERTEX_SHADER or GL_FRAGMENT_SHADER */
+	static GLObject create(GLenum shaderType = 0)
+	{
+		GLObject o;
+		o.name = glResourceCreate(Kind, shaderType);
+		return o;
+	}
+	void reset()
+	{
+		if(name)
+			glResourceDelete(Kind, name);
+		name = 0;
+	}
+	operator GLuint() const { return name; }
+
+private:
+	GLuint name;
+};
+
+typedef GLObject<glVertexArrays> GLVertexArray;
+typedef GLObject<glBuffers> GLBuffer;
+typedef GLObject<glShaders> GLShader;
+typedef GLObject<glPrograms> GLProgram;
+typedef GLObject<glTextures> GLTexture;
+
+#endif
@@ -0,0 +1,123 @@
+#include "headless.h"
+
+#include <stdio.h>
+#include <vector>
+
+#include <glad/glad.h>
+
+#ifdef __linux__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+static GLuint framebuffer, colourBuffer, depthBuffer;
+static int fbWidth, fbHeight;
+
+/* Mesa's surfaceless platform needs neither X nor a GPU, llvmpipe is enough */
+static EGLDisplay openDisplay()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(getPlatformDisplay) {
+		EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if(d != EGL_NO_DISPLAY)
+			return d;
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool initHeadless(int width, int height)
+{
+	EGLint major, minor;
+	display = openDisplay();
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		fprintf(stderr, "headless: no EGL display\n");
+		return false;
+	}
+	if(!eglBindAPI(EGL_OPENGL_API)) {
+		fprintf(stderr, "headless: EGL %d.%d has no desktop OpenGL\n", major, minor);
+		return false;
+	}
+	const EGLint configAttribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	// we never draw to an EGL surface, surfaceless Mesa is fine without a config
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint configs = 0;
+	if(!eglChooseConfig(display, configAttribs, &config, 1, &configs) || configs == 0)
+		config = EGL_NO_CONFIG_KHR;
+	// same context as the window gets from initGLFW
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		fprintf(stderr, "headless: can't make a surfaceless OpenGL 3.3 context current\n");
+		return false;
+	}
+	gladLoadGLLoader((GLADloadproc) eglGetProcAddress);
+
+	fbWidth = width; fbHeight = height;
+	glGenRenderbuffers(1, &colourBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "headless: framebuffer incomplete\n");
+		return false;
+	}
+	printf("headless: EGL %d.%d, %dx%d framebuffer\n", major, minor, width, height);
+	return true;
+}
+
+void finishHeadlessFrame()
+{
+	glFinish();
+}
+
+unsigned headlessChecksum()
+{
+	std::vector<unsigned char> pixels(4*fbWidth*fbHeight);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, fbWidth, fbHeight, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	unsigned hash = 2166136261u;
+	for(size_t i=0;i<pixels.size();i++)
+		hash = (hash ^ pixels[i])*16777619u;
+	return hash;
+}
+
+void closeHeadless()
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colourBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+}
+
+#else
+
+bool initHeadless(int width, int height)
+{
+	fprintf(stderr, "headless: only available on Linux (EGL)\n");
+	return false;
+}
+
+void finishHeadlessFrame() {}
+unsigned headlessChecksum() { return 0; }
+void closeHeadless() {}
+
+#endif
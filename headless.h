@@ -0,0 +1,17 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+/* Offscreen GL 3.3 core context for runs without a display (--headless).
+ * The context is surfaceless EGL, draw() renders into a framebuffer object
+ * of the window size instead of a window. Linux only, elsewhere
+ * initHeadless() reports that it isn't available. */
+
+/* Create the context and the framebuffer, returns false with a message on stderr */
+bool initHeadless(int width, int height);
+/* Wait for the frame to finish rendering, so a frame's time covers the rasteriser too */
+void finishHeadlessFrame();
+/* FNV-1a hash of the framebuffer, to compare frames between builds */
+unsigned headlessChecksum();
+void closeHeadless();
+
+#endif
@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec2 texCoord;
+
+uniform sampler2D atlas;
+uniform vec3 textColor;
+
+out vec3 color;
+
+void main()
+{
+	// the atlas is one channel, lit texels are 1
+	if(texture(atlas, texCoord).r < 0.5)
+		discard;
+	color = textColor;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+// one instance per glyph : pen position in pixels and glyph index in the atlas
+layout (location = 0) in vec3 glyph;
+
+uniform vec2 screen;      // window size in pixels
+uniform vec2 glyphSize;   // size of one glyph on screen in pixels
+uniform vec2 atlasStep;   // atlas width of one glyph cell and of the glyph itself, in texture coordinates
+
+out vec2 texCoord;
+
+void main ()
+{
+	// the four corners of the quad come from the vertex id, no vertex buffer needed
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+	vec2 pixel = glyph.xy + corner*glyphSize;
+	texCoord = vec2(glyph.z*atlasStep.x + corner.x*atlasStep.y, 1.0 - corner.y);
+
+	gl_Position = vec4(pixel/screen*2.0 - 1.0, 0, 1);
+}
@@ -0,0 +1,65 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+/* Keyboard and mouse events on their way from the GLFW callbacks to the simulation.
+ * Single producer (the thread polling GLFW), single consumer (the simulate job),
+ * no locks. Events carry the time they arrived so the simulation applies each one
+ * at the first tick boundary after it. */
+
+enum InputType { inputKey, inputChar, inputButton, inputCursor, inputScroll };
+
+struct InputEvent {
+	double time;      // glfwGetTime() when the callback ran
+	short type;       // InputType
+	short code;       // key, character or mouse button
+	short action;     // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+	short mods;       // GLFW_MOD_* bits
+	float x, y;       // cursor position in pixels, or scroll offsets
+};
+
+const size_t inputQueueSize = 1024;   // power of two
+
+class InputQueue {
+public:
+	InputQueue() : head(0), tail(0), dropped(0) {}
+
+	/* Producer side. A full queue drops the event, a frame never holds that many */
+	bool push(const InputEvent &e)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if(h - tail.load(std::memory_order_acquire) == inputQueueSize) {
+			dropped++;
+			return false;
+		}
+		ring[h & (inputQueueSize-1)] = e;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* Consumer side, oldest event or NULL */
+	const InputEvent *front() const
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if(t == head.load(std::memory_order_acquire))
+			return NULL;
+		return &ring[t & (inputQueueSize-1)];
+	}
+
+	void pop()
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	long droppedEvents() const { return dropped; }
+
+private:
+	InputEvent ring[inputQueueSize];
+	alignas(64) std::atomic<size_t> head;    // written by the producer only
+	alignas(64) std::atomic<size_t> tail;    // written by the consumer only
+	long dropped;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "jobSystem.h"
+#include "trace.h"
+#include "wallClock.h"
+
+#include <algorithm>
+
+static thread_local int workerIndex = 0;
+
+const int idleYields = 64;      // a waiter yields this often before it sleeps
+
+JobSystem::JobSystem(int numThreads)
+	: queued(0), graphLeft(0), sleepers(0), stopping(false)
+{
+	if(numThreads <= 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numWorkers = numThreads;
+	for(int i=0;i<numWorkers;i++) {
+		workers.push_back(new Worker);
+		workers[i]->used = 0;
+	}
+	resetStats();
+	for(int i=1;i<numWorkers;i++)
+		threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(size_t i=0;i<threads.size();i++)
+		threads[i].join();
+	for(int i=0;i<numWorkers;i++)
+		delete workers[i];
+}
+
+void JobSystem::JobQueue::pushBack(Job *job)
+{
+	if(ring.empty())
+		ring.resize(1024);
+	if(tail - head == ring.size()) {
+		std::vector<Job*> bigger(ring.size()*2);
+		for(size_t i=head;i<tail;i++)
+			bigger[i & (bigger.size()-1)] = ring[i & (ring.size()-1)];
+		ring.swap(bigger);
+	}
+	ring[tail++ & (ring.size()-1)] = job;
+}
+
+int JobSystem::self() const
+{
+	return workerIndex;
+}
+
+Job *JobSystem::newJob(const char *name)
+{
+	Worker *w = workers[self()];
+	if(w->used == w->pool.size())
+		w->pool.emplace_back();
+	Job *job = &w->pool[w->used++];
+	job->fn = nullptr;
+	job->range = nullptr;
+	job->begin = job->end = 0; job->grain = 1;
+	job->parent = NULL;
+	job->unfinished.store(1);
+	job->depsLeft.store(0);
+	job->dependents.clear();
+	job->name = name;
+	return job;
+}
+
+Job *JobSystem::add(const std::function<void()> &fn, const char *name)
+{
+	Job *job = newJob(name);
+	job->fn = fn;
+	graph.push_back(job);
+	return job;
+}
+
+Job *JobSystem::addParallelFor(int n, int grain, const std::function<void(int,int)> &fn, const char *name)
+{
+	Job *job = newJob(name);
+	job->range = fn;
+	job->end = n;
+	job->grain = std::max(grain, 1);
+	graph.push_back(job);
+	return job;
+}
+
+void JobSystem::depend(Job *job, Job *before)
+{
+	before->dependents.push_back(job);
+	job->depsLeft++;
+}
+
+void JobSystem::push(Job *job)
+{
+	Worker *w = workers[self()];
+	{
+		std::lock_guard<std::mutex> guard(w->lock);
+		w->queue.pushBack(job);
+	}
+	queued++;
+	wakeSleepers();
+}
+
+void JobSystem::wakeSleepers()
+{
+	if(sleepers.load() > 0) {
+		std::lock_guard<std::mutex> guard(sleepLock);
+		wake.notify_all();
+	}
+}
+
+Job *JobSystem::pop(int self)
+{
+	Worker *w = workers[self];
+	std::lock_guard<std::mutex> guard(w->lock);
+	if(w->queue.empty())
+		return NULL;
+	Job *job = w->queue.popBack();
+	queued--;
+	return job;
+}
+
+Job *JobSystem::steal(int self)
+{
+	for(int i=1;i<numWorkers;i++) {
+		Worker *w = workers[(self + i) % numWorkers];
+		std::lock_guard<std::mutex> guard(w->lock);
+		if(w->queue.empty())
+			continue;
+		Job *job = w->queue.popFront();
+		queued--;
+		return job;
+	}
+	return NULL;
+}
+
+/* A job is done once its own body and all of its chunks are */
+void JobSystem::finish(Job *job)
+{
+	int left = --job->unfinished;
+	if(left > 0) {
+		// an immediate parallelFor's caller waits for its count to reach 1
+		if(left == 1 && !job->dependents.size())
+			wakeSleepers();
+		return;
+	}
+	if(job->parent) {
+		finish(job->parent);
+		return;
+	}
+	for(size_t i=0;i<job->dependents.size();i++)
+		if(--job->dependents[i]->depsLeft == 0)
+			push(job->dependents[i]);
+	if(--graphLeft == 0)
+		wakeSleepers();
+}
+
+/* Helps with other jobs until done() holds. With nothing to steal it yields for a
+ * while and then sleeps, new jobs and finished ones wake it. */
+template <class F>
+void JobSystem::helpUntil(int self, const F &done)
+{
+	int idle = 0;
+	while(!done()) {
+		if(runOne(self)) {
+			idle = 0;
+			continue;
+		}
+		if(++idle < idleYields) {
+			std::this_thread::yield();
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleepLock);
+		sleepers++;
+		wake.wait(guard, [&] { return done() || queued.load() > 0; });
+		sleepers--;
+	}
+}
+
+void JobSystem::execute(int self, Job *job)
+{
+	TRACE_ZONE(job->name);
+	double start = wallClock();
+	if(job->parent)
+		job->parent->range(job->begin, job->end);
+	else if(job->range) {
+		// split into chunks, keep the first one for ourselves
+		int chunks = (job->end + job->grain - 1)/job->grain;
+		job->unfinished += std::max(chunks - 1, 0);
+		for(int c=1;c<chunks;c++) {
+			Job *chunk = newJob(job->name);
+			chunk->parent = job;
+			chunk->begin = c*job->grain;
+			chunk->end = std::min(job->end, chunk->begin + job->grain);
+			push(chunk);
+		}
+		if(chunks > 0)
+			job->range(0, std::min(job->end, job->grain));
+	}
+	else if(job->fn)
+		job->fn();
+	Worker *w = workers[self];
+	{
+		std::lock_guard<std::mutex> guard(w->statsLock);
+		w->stats.busy += wallClock() - start;
+		w->stats.jobs++;
+	}
+	finish(job);
+}
+
+bool JobSystem::runOne(int self)
+{
+	Job *job = pop(self);
+	if(!job) {
+		job = steal(self);
+		if(!job)
+			return false;
+		std::lock_guard<std::mutex> guard(workers[self]->statsLock);
+		workers[self]->stats.steals++;
+	}
+	execute(self, job);
+	return true;
+}
+
+void JobSystem::workerLoop(int self)
+{
+	workerIndex = self;
+	TRACE_THREAD("job worker");
+	while(true) {
+		if(runOne(self))
+			continue;
+		std::unique_lock<std::mutex> guard(sleepLock);
+		sleepers++;
+		wake.wait(guard, [this] { return stopping || queued.load() > 0; });
+		sleepers--;
+		if(stopping)
+			return;
+	}
+}
+
+void JobSystem::run()
+{
+	graphLeft.store((int)graph.size());
+	// pick the roots before starting any, a finished root may already release the others
+	roots.clear();
+	for(size_t i=0;i<graph.size();i++)
+		if(graph[i]->depsLeft.load() == 0)
+			roots.push_back(graph[i]);
+	for(size_t i=0;i<roots.size();i++)
+		push(roots[i]);
+	helpUntil(0, [this] { return graphLeft.load() == 0; });
+	graph.clear();
+	// nothing is in flight any more, recycle every job
+	for(int i=0;i<numWorkers;i++)
+		workers[i]->used = 0;
+}
+
+void JobSystem::parallelForRef(int n, int grain, const std::function<void(int,int)> &fn)
+{
+	grain = std::max(grain, 1);
+	if(n <= grain || numWorkers == 1) {
+		if(n > 0)
+			fn(0, n);
+		return;
+	}
+	// a parent nobody waits on through the graph, we watch its counter instead
+	Job *job = newJob("parallelFor");
+	job->range = fn;
+	job->end = n;
+	job->grain = grain;
+	job->unfinished++;
+	int me = self();
+	execute(me, job);
+	helpUntil(me, [job] { return job->unfinished.load() <= 1; });
+}
+
+void JobSystem::stats(std::vector<WorkerStats> &out, double &seconds) const
+{
+	out.resize(numWorkers);
+	for(int i=0;i<numWorkers;i++) {
+		std::lock_guard<std::mutex> guard(workers[i]->statsLock);
+		out[i] = workers[i]->stats;
+	}
+	seconds = wallClock() - statsStart;
+}
+
+void JobSystem::resetStats()
+{
+	for(int i=0;i<numWorkers;i++) {
+		std::lock_guard<std::mutex> guard(workers[i]->statsLock);
+		workers[i]->stats.busy = 0;
+		workers[i]->stats.jobs = 0;
+		workers[i]->stats.steals = 0;
+	}
+	statsStart = wallClock();
+}
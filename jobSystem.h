@@ -0,0 +1,106 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Work-stealing scheduler for the per-frame stages.
+ * Every worker owns a queue, it pops its own newest job and steals the oldest job
+ * of the others when it runs dry. The thread calling run() is worker 0.
+ *
+ * A frame is built as a graph: add() / addParallelFor() create jobs, depend() adds
+ * edges, run() executes the graph and returns when every job finished. */
+
+struct Job {
+	std::function<void()> fn;
+	std::function<void(int,int)> range;   // parallel-for body
+	int begin, end, grain;
+	Job *parent;                          // the parallel-for a chunk belongs to
+	std::atomic<int> unfinished;          // itself plus chunks still running
+	std::atomic<int> depsLeft;
+	std::vector<Job*> dependents;
+	const char *name;
+};
+
+struct WorkerStats {
+	double busy;      // seconds spent running jobs
+	long jobs;
+	long steals;
+};
+
+class JobSystem {
+public:
+	explicit JobSystem(int numThreads = 0);
+	~JobSystem();
+
+	int size() const { return numWorkers; }
+
+	Job *add(const std::function<void()> &fn, const char *name);
+	/* Calls fn(begin,end) over [0,n) in chunks of grain items, possibly on several workers */
+	Job *addParallelFor(int n, int grain, const std::function<void(int,int)> &fn, const char *name);
+	/* job starts only after before finished */
+	void depend(Job *job, Job *before);
+	void run();
+
+	/* Immediate parallel loop, also usable from inside a job. The caller helps until it is done.
+	 * fn is only referenced, so lambdas with many captures don't cost an allocation. */
+	template <class F>
+	void parallelFor(int n, int grain, const F &fn)
+	{
+		parallelForRef(n, grain, std::function<void(int,int)>(std::cref(fn)));
+	}
+
+	/* Per-worker counters since the last reset, along with the wall time they cover */
+	void stats(std::vector<WorkerStats> &out, double &seconds) const;
+	void resetStats();
+
+private:
+	/* Ring of queued jobs, only grows, so steady frames don't touch the heap */
+	struct JobQueue {
+		std::vector<Job*> ring;
+		size_t head = 0, tail = 0;
+		bool empty() const { return head == tail; }
+		void pushBack(Job *job);
+		Job *popBack() { return ring[--tail & (ring.size()-1)]; }
+		Job *popFront() { return ring[head++ & (ring.size()-1)]; }
+	};
+
+	struct Worker {
+		std::mutex lock;
+		JobQueue queue;
+		std::deque<Job> pool;    // jobs created by this worker, recycled every run()
+		size_t used;
+		WorkerStats stats;
+		std::mutex statsLock;
+	};
+
+	void parallelForRef(int n, int grain, const std::function<void(int,int)> &fn);
+	Job *newJob(const char *name);
+	void push(Job *job);
+	void wakeSleepers();
+	template <class F> void helpUntil(int self, const F &done);
+	Job *pop(int self);
+	Job *steal(int self);
+	void execute(int self, Job *job);
+	void finish(Job *job);
+	bool runOne(int self);
+	void workerLoop(int self);
+	int self() const;
+
+	int numWorkers;
+	std::vector<Worker*> workers;
+	std::vector<std::thread> threads;
+	std::vector<Job*> graph, roots;
+	std::atomic<int> queued, graphLeft, sleepers;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	bool stopping;
+	double statsStart;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "gameLogic.h"
+
+/* The laser path on its own in an object, so make trigtest can check with nm that
+ * traceLaser and the mirror searches it inlines call no trig functions */
+int probeLaser(float cannonShift, float cannonAngle, const float *mirrorx, const float *mirrory, const float *mirrorAng,
+		int nmirrors, const MirrorGrid *grid, float *segments)
+{
+	int n = 0;
+	traceLaser(cannonShift, cannonAngle, mirrorx, mirrory, mirrorAng, nmirrors,
+			[](float, float, float, int, float*, float*) { return 0; },
+			[&](float x1, float y1, float x2, float y2) {
+				segments[4*n] = x1; segments[4*n+1] = y1; segments[4*n+2] = x2; segments[4*n+3] = y2;
+				n++;
+			}, grid);
+	return n;
+}
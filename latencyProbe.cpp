@@ -0,0 +1,221 @@
+#include "latencyProbe.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const double bucketWidth = 0.0005;
+
+void LatencyHistogram::add(double seconds)
+{
+	if(seconds < 0)
+		seconds = 0;
+	int b = (int)(seconds/bucketWidth);
+	count[b < buckets ? b : buckets-1]++;
+	total++;
+	sum += seconds;
+	if(seconds > worst)
+		worst = seconds;
+}
+
+/* Upper edge of the bucket holding the p-th sample, the overflow bucket gives the worst */
+double LatencyHistogram::percentile(double p) const
+{
+	long need = (long)(p*total + 0.5), seen = 0;
+	for(int b=0;b<buckets-1;b++) {
+		seen += count[b];
+		if(seen >= need && seen > 0)
+			return (b+1)*bucketWidth < worst ? (b+1)*bucketWidth : worst;
+	}
+	return worst;
+}
+
+void LatencyHistogram::print(const char *name) const
+{
+	if(total == 0) {
+		printf("latency: %-18s no samples\n", name);
+		return;
+	}
+	printf("latency: %-18s %6ld  mean %6.2f  p50 %6.2f  p90 %6.2f  p99 %6.2f  worst %6.2f ms\n",
+			name, total, 1000*sum/total, 1000*percentile(0.5), 1000*percentile(0.9),
+			1000*percentile(0.99), 1000*worst);
+}
+
+void LatencyHistogram::plot() const
+{
+	int last = -1; long most = 0;
+	for(int b=0;b<buckets;b++)
+		if(count[b]) {
+			last = b;
+			if(count[b] > most)
+				most = count[b];
+		}
+	for(int b=0;b<=last;b++) {
+		char bar[51];
+		int n = (int)(50*count[b]/most);
+		memset(bar, '#', n);
+		bar[n] = 0;
+		if(b == buckets-1)
+			printf("latency:   >%5.1f ms |%s %ld\n", 1000*b*bucketWidth, bar, count[b]);
+		else
+			printf("latency:   %6.1f ms |%s %ld\n", 1000*(b+1)*bucketWidth, bar, count[b]);
+	}
+}
+
+LatencyProbe::LatencyProbe(double (*clock)())
+	: clock(clock), numPending(0), nextSlot(0), drawing(-1), dropped(0), abandoned(0)
+{
+	memset(&toTick, 0, sizeof(toTick));
+	memset(&toDraw, 0, sizeof(toDraw));
+	memset(&toPhoton, 0, sizeof(toPhoton));
+	memset(total, 0, sizeof(total));
+	for(int i=0;i<maxFrames;i++) {
+		frames[i].fence = NULL;
+		glGenQueries(1, &frames[i].query);
+	}
+}
+
+LatencyProbe::~LatencyProbe()
+{
+	for(int i=0;i<maxFrames;i++) {
+		if(frames[i].fence)
+			glDeleteSync(frames[i].fence);
+		glDeleteQueries(1, &frames[i].query);
+	}
+}
+
+void LatencyProbe::inputApplied(double inputTime, long tick, LatencyKind kind)
+{
+	record(inputTime, tick, kind, true);
+}
+
+void LatencyProbe::tickApplied(long tick, LatencyKind kind)
+{
+	record(clock(), tick, kind, false);
+}
+
+void LatencyProbe::record(double inputTime, long tick, LatencyKind kind, bool fromInput)
+{
+	if(numPending == maxPending) {
+		dropped++;
+		return;
+	}
+	Sample &s = pending[numPending++];
+	s.input = inputTime;
+	s.applied = clock();
+	s.tick = tick;
+	s.frame = -1;
+	s.kind = kind;
+	s.fromInput = fromInput;
+	s.slot = -1;
+}
+
+void LatencyProbe::frameDrawn(long frame)
+{
+	drawing = -1;
+	for(int i=0;i<numPending;i++)
+		if(pending[i].slot < 0) {
+			if(drawing < 0) {
+				drawing = nextSlot;
+				// the GPU is maxFrames behind, only then does the probe wait, and
+				// not forever: a frame still not done is given up before its slot is reused
+				if(frames[drawing].fence && !finished(drawing, true))
+					abandon(drawing);
+			}
+			pending[i].slot = drawing;
+			pending[i].frame = frame;
+			pending[i].drawn = clock();
+		}
+	if(drawing >= 0)
+		frames[drawing].frame = frame;
+}
+
+void LatencyProbe::frameSwapped()
+{
+	if(drawing >= 0) {
+		FrameFence &f = frames[drawing];
+		// the timestamp before the fence, so a signalled fence means the query is ready
+		glQueryCounter(f.query, GL_TIMESTAMP);
+		f.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		GLint64 gpuNow;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		f.offset = clock() - gpuNow*1e-9;
+		nextSlot = (nextSlot + 1) % maxFrames;
+		drawing = -1;
+	}
+	poll();
+}
+
+void LatencyProbe::poll()
+{
+	for(int i=0;i<maxFrames;i++)
+		if(frames[i].fence)
+			finished(i, false);
+}
+
+/* Adds the samples of a finished frame to the histograms */
+bool LatencyProbe::finished(int slot, bool wait)
+{
+	FrameFence &f = frames[slot];
+	GLenum r = glClientWaitSync(f.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 100000000 : 0);
+	if(r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED)
+		return false;
+	GLuint64 done;
+	glGetQueryObjectui64v(f.query, GL_QUERY_RESULT, &done);
+	double photon = done*1e-9 + f.offset;
+	glDeleteSync(f.fence);
+	f.fence = NULL;
+
+	for(int i=0;i<numPending;) {
+		Sample &s = pending[i];
+		if(s.slot != slot) {
+			i++;
+			continue;
+		}
+		// the two clocks can disagree by a little, a frame never finishes before it is drawn
+		double shown = photon > s.drawn ? photon : s.drawn;
+		if(s.fromInput)
+			toTick.add(s.applied - s.input);
+		toDraw.add(s.drawn - s.applied);
+		toPhoton.add(shown - s.drawn);
+		total[s.kind].add(shown - s.input);
+		s = pending[--numPending];
+	}
+	return true;
+}
+
+/* Deletes a fence that didn't signal and drops the samples waiting on it, so they
+ * aren't credited to the next frame that uses the slot */
+void LatencyProbe::abandon(int slot)
+{
+	glDeleteSync(frames[slot].fence);
+	frames[slot].fence = NULL;
+	for(int i=0;i<numPending;) {
+		if(pending[i].slot == slot) {
+			pending[i] = pending[--numPending];
+			abandoned++;
+		}
+		else
+			i++;
+	}
+}
+
+void LatencyProbe::report()
+{
+	for(int i=0;i<maxFrames;i++)
+		if(frames[i].fence)
+			finished(i, true);
+	toTick.print("input -> tick");
+	toDraw.print("tick -> draw");
+	toPhoton.print("draw -> GPU done");
+	total[latencyShot].print("shot, total");
+	total[latencyMove].print("move, total");
+	for(int k=0;k<2;k++)
+		if(total[k].total) {
+			printf("latency: %s input to photon\n", k == latencyShot ? "shot" : "move");
+			total[k].plot();
+		}
+	if(dropped)
+		printf("latency: %ld inputs not timed, more than %d waiting\n", dropped, maxPending);
+	if(abandoned)
+		printf("latency: %ld inputs not timed, their frame took over 100 ms on the GPU\n", abandoned);
+}
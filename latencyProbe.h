@@ -0,0 +1,79 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <glad/glad.h>
+
+/* Input-to-photon latency, --latency.
+ * Each shot or move is timed at four points: when the input arrived, when a tick
+ * applied it, when the first frame showing it started drawing, and when that frame
+ * was done on the GPU. The last one comes from a fence inserted after the swap,
+ * with a timestamp query next to it so the time is exact even when the fence is
+ * only seen a frame later. Every stage goes into a histogram printed by report(). */
+
+enum LatencyKind { latencyShot, latencyMove };
+
+struct LatencyHistogram {
+	static const int buckets = 100;       // 0.5 ms each, the last one holds everything above
+	long count[buckets];
+	long total;
+	double sum, worst;
+
+	void add(double seconds);
+	double percentile(double p) const;
+	void print(const char *name) const;
+	void plot() const;
+};
+
+class LatencyProbe {
+public:
+	/* clock is the one input events are stamped with */
+	explicit LatencyProbe(double (*clock)());
+	~LatencyProbe();
+
+	/* A tick applied an input that arrived at inputTime */
+	void inputApplied(double inputTime, long tick, LatencyKind kind);
+	/* A tick made its own input, the bot's shots. Timed from the tick on, so
+	 * they stay out of the input -> tick histogram */
+	void tickApplied(long tick, LatencyKind kind);
+	/* The frame about to be drawn shows everything applied so far */
+	void frameDrawn(long frame);
+	/* After the swap (or glFinish offscreen), fences the frame */
+	void frameSwapped();
+	/* Collects the frames the GPU has finished, without waiting */
+	void poll();
+	void report();
+
+private:
+	static const int maxPending = 256;
+	static const int maxFrames = 8;
+
+	struct Sample {
+		double input, applied, drawn;
+		long tick, frame;
+		int kind;
+		bool fromInput;      // false for tickApplied, there was no input to wait for
+		int slot;            // frame fence it waits on, -1 until drawn
+	};
+	struct FrameFence {
+		GLsync fence;        // NULL when the slot is free
+		GLuint query;        // GL_TIMESTAMP written when the frame's commands finish
+		double offset;       // clock() minus GPU time, taken when the fence went in
+		long frame;
+	};
+
+	void record(double inputTime, long tick, LatencyKind kind, bool fromInput);
+	bool finished(int slot, bool wait);
+	void abandon(int slot);
+
+	double (*clock)();
+	Sample pending[maxPending];
+	int numPending;
+	FrameFence frames[maxFrames];
+	int nextSlot;
+	int drawing;             // slot of the frame being drawn, -1 if it shows no new input
+	long dropped;
+	long abandoned;          // samples whose frame's fence didn't signal in time
+	LatencyHistogram toTick, toDraw, toPhoton, total[2];
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "level.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool levelValid(const LevelHeader *l, size_t len)
+{
+	if(len < sizeof(LevelHeader) || memcmp(l->magic, levelMagic, sizeof(levelMagic)) != 0)
+		return false;
+	if(l->version != levelVersion || l->size != len || l->gridCols == 0 || l->gridRows == 0)
+		return false;
+	if(l->size != levelSize(l->mirrorCount, l->fallCount, l->gridCols*l->gridRows, l->cellEntries))
+		return false;
+	// the grid is trusted by the laser, so its indices are checked once here
+	const uint32_t *start = levelCellStart(l), *cells = levelCellMirrors(l);
+	int n = l->gridCols*l->gridRows;
+	if(start[0] != 0 || start[n] != l->cellEntries)
+		return false;
+	for(int c=0;c<n;c++)
+		if(start[c] > start[c+1])
+			return false;
+	for(uint32_t k=0;k<l->cellEntries;k++)
+		if(cells[k] >= l->mirrorCount)
+			return false;
+	return true;
+}
+
+const int targetPerCell = 2;         // mirrors per grid cell the grid is sized for
+const int maxGridSide = 1024;
+
+/* Bounding box of a mirror, a random angle can end anywhere in the first quadrant */
+static void mirrorBox(const LevelMirror &m, float box[4])
+{
+	float c = 1, s = 1;
+	if(m.angle != randomAngle) {
+		int a = angleIndex(m.angle);
+		c = cosIndex(a); s = sinIndex(a);
+	}
+	box[0] = m.x; box[1] = m.y;
+	box[2] = m.x + mirrorLength*c; box[3] = m.y + mirrorLength*s;
+}
+
+void buildMirrorGrid(const LevelMirror *mirrors, int n, std::vector<uint32_t> &cellStart,
+		std::vector<uint32_t> &cellMirrors, MirrorGrid &grid)
+{
+	float gx0 = 0, gy0 = 0, gx1 = 1, gy1 = 1;
+	for(int i=0;i<n;i++) {
+		float box[4];
+		mirrorBox(mirrors[i], box);
+		if(i == 0 || box[0] < gx0) gx0 = box[0];
+		if(i == 0 || box[1] < gy0) gy0 = box[1];
+		if(i == 0 || box[2] > gx1) gx1 = box[2];
+		if(i == 0 || box[3] > gy1) gy1 = box[3];
+	}
+	float gw = gx1 - gx0 + 0.01f, gh = gy1 - gy0 + 0.01f;
+	int cells = n/targetPerCell > 1 ? n/targetPerCell : 1;
+	int cols = (int)ceil(sqrt(cells*gw/gh));
+	cols = cols < 1 ? 1 : cols > maxGridSide ? maxGridSide : cols;
+	int rows = (cells + cols - 1)/cols;
+	rows = rows < 1 ? 1 : rows > maxGridSide ? maxGridSide : rows;
+	grid.cols = cols; grid.rows = rows;
+	grid.x0 = gx0; grid.y0 = gy0;
+	grid.cellW = gw/cols; grid.cellH = gh/rows;
+	grid.loose = -1;
+
+	// two passes, count then fill, so each cell's mirrors are contiguous
+	cellStart.assign(cols*rows + 1, 0);
+	auto overlap = [&](int i, int pass) {
+		const LevelMirror &m = mirrors[i];
+		float box[4];
+		mirrorBox(m, box);
+		int x0 = (int)((box[0] - gx0)/grid.cellW), x1 = (int)((box[2] - gx0)/grid.cellW);
+		for(int x=x0;x<=x1 && x<cols;x++) {
+			float ylow = box[1], yhigh = box[3];
+			if(m.angle != randomAngle && x0 != x1) {
+				// the segment's y over this column, it rises left to right, within a single
+				// column that is the whole box, and a near vertical slope only loses precision
+				float slope = tanIndex(angleIndex(m.angle));
+				float left = fmaxf(box[0], gx0 + x*grid.cellW), right = fminf(box[2], gx0 + (x+1)*grid.cellW);
+				// with a little slack so rounding can't drop a cell the segment clips
+				ylow = fmaxf(box[1], m.y + (left - m.x)*slope) - 1e-4f;
+				yhigh = fminf(box[3], m.y + (right - m.x)*slope) + 1e-4f;
+			}
+			int y0 = (int)fmaxf((ylow - gy0)/grid.cellH, 0), y1 = (int)((yhigh - gy0)/grid.cellH);
+			for(int y=y0;y<=y1 && y<rows;y++) {
+				if(pass == 0)
+					cellStart[y*cols + x + 1]++;
+				else
+					cellMirrors[cellStart[y*cols + x]++] = i;
+			}
+		}
+	};
+	for(int i=0;i<n;i++)
+		overlap(i, 0);
+	for(int c=0;c<cols*rows;c++)
+		cellStart[c+1] += cellStart[c];
+	cellMirrors.resize(cellStart[cols*rows]);
+	for(int i=0;i<n;i++)
+		overlap(i, 1);
+	// filling moved every start to the next cell's, shift them back
+	for(int c=cols*rows;c>0;c--)
+		cellStart[c] = cellStart[c-1];
+	cellStart[0] = 0;
+	grid.cellStart = cellStart.data();
+	grid.cellMirrors = cellMirrors.data();
+}
+
+const LevelHeader *mapLevel(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "level: can't open %s\n", path);
+		return NULL;
+	}
+	struct stat st;
+	void *p = MAP_FAILED;
+	if(fstat(fd, &st) == 0 && st.st_size > 0)
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) {
+		fprintf(stderr, "level: can't map %s\n", path);
+		return NULL;
+	}
+	const LevelHeader *l = (const LevelHeader*)p;
+	if(!levelValid(l, st.st_size)) {
+		fprintf(stderr, "level: %s is not a version %u compiled level, rebuild it with levelc\n", path, levelVersion);
+		munmap(p, st.st_size);
+		return NULL;
+	}
+	return l;
+}
+
+void unmapLevel(const LevelHeader *l)
+{
+	munmap((void*)l, l->size);
+}
@@ -0,0 +1,84 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "gameLogic.h"
+
+/* Compiled levels. levelc turns a text level (levels/<name>.lvl) into this layout at build
+ * time: a LevelHeader, then mirrorCount LevelMirrors, fallCount LevelFalls, the
+ * mirror grid's cellStart (cols*rows+1 offsets) and cellMirrors (cellEntries
+ * indices). Everything is ready to use straight from an mmap of the file. */
+
+const char levelMagic[8] = {'B','R','I','C','K','L','V','L'};
+/* bump whenever the layout changes */
+const uint32_t levelVersion = 1;
+
+/* Mirror angles are whole degrees in [1, 89], randomAngle picks one when the level loads */
+const float randomAngle = -1;
+
+struct LevelMirror {
+	float x, y, angle;
+};
+
+/* From time seconds of play on, bricks fall at rate */
+struct LevelFall {
+	float time, rate;
+};
+
+struct LevelHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t size;                   // bytes, everything included
+
+	float cannonMin, cannonMax;      // cannon rail
+	float bucketStart[2], bucketMin[2], bucketMax[2];   // red, green
+	float spawnMin, spawnMax;        // bricks spawn uniformly in x over this range
+	uint32_t colourWeight[2];        // odds of a red and a green brick
+
+	uint32_t mirrorCount, fallCount;
+	uint32_t gridCols, gridRows, cellEntries;
+	float gridX, gridY, cellW, cellH;
+};
+
+static_assert(sizeof(LevelHeader) % 4 == 0, "arrays follow the header");
+
+inline size_t levelSize(uint32_t mirrors, uint32_t falls, uint32_t cells, uint32_t entries)
+{
+	return sizeof(LevelHeader) + mirrors*sizeof(LevelMirror) + falls*sizeof(LevelFall) +
+		(cells + 1 + entries)*sizeof(uint32_t);
+}
+
+inline const LevelMirror *levelMirrors(const LevelHeader *l) { return (const LevelMirror*)(l + 1); }
+inline const LevelFall *levelFalls(const LevelHeader *l) { return (const LevelFall*)(levelMirrors(l) + l->mirrorCount); }
+inline const uint32_t *levelCellStart(const LevelHeader *l) { return (const uint32_t*)(levelFalls(l) + l->fallCount); }
+inline const uint32_t *levelCellMirrors(const LevelHeader *l) { return levelCellStart(l) + l->gridCols*l->gridRows + 1; }
+
+inline MirrorGrid levelGrid(const LevelHeader *l)
+{
+	MirrorGrid g;
+	g.cols = l->gridCols; g.rows = l->gridRows;
+	g.x0 = l->gridX; g.y0 = l->gridY; g.cellW = l->cellW; g.cellH = l->cellH;
+	g.cellStart = levelCellStart(l);
+	g.cellMirrors = levelCellMirrors(l);
+	g.loose = -1;
+	return g;
+}
+
+/* Bin n mirrors into a grid over the union of their boxes, sized for a couple per cell.
+ * A mirror goes into every cell its segment crosses, one at randomAngle into its whole box.
+ * cellStart and cellMirrors receive the arrays, grid points into them. levelc builds the
+ * compiled grid with this, the game rebuilds with it after a mirror was dragged. */
+void buildMirrorGrid(const LevelMirror *mirrors, int n, std::vector<uint32_t> &cellStart,
+		std::vector<uint32_t> &cellMirrors, MirrorGrid &grid);
+
+/* Magic, version, sizes and grid indices agree with the len bytes at l */
+bool levelValid(const LevelHeader *l, size_t len);
+
+/* Map a compiled level read-only, NULL with a message if it is missing or doesn't match this build */
+const LevelHeader *mapLevel(const char *path);
+void unmapLevel(const LevelHeader *l);
+
+#endif
@@ -0,0 +1,165 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "level.h"
+
+/* Compiles a text level into the binary layout of level.h, mirror grid included,
+ * so the game maps the file and has nothing left to build.
+ * usage: levelc levels/<name>.lvl levels/<name>.lvlb
+ *
+ * One statement per line, # starts a comment. Anything not given keeps the
+ * classic game's value.
+ *   cannon <min y> <max y>
+ *   bucket red|green <start x> <min x> <max x>
+ *   spawn <min x> <max x> <red weight> <green weight>
+ *   fall <seconds> <rate>                         from then on, rate in [0.01, 0.05]
+ *   mirror <x> <y> <degrees 1-89 | random>
+ *   scatter <count> <min x> <max x> <min y> <max y> <seed>   count mirrors at seeded random spots */
+
+static const char *path;
+static int lineNumber;
+
+static void fail(const char *message)
+{
+	fprintf(stderr, "%s:%d: %s\n", path, lineNumber, message);
+	exit(1);
+}
+
+int main (int argc, char** argv)
+{
+	if(argc < 3) {
+		fprintf(stderr, "usage: %s <level source> <compiled level>\n", argv[0]);
+		return 1;
+	}
+	path = argv[1];
+	FILE *in = fopen(path, "r");
+	if(!in) {
+		fprintf(stderr, "can't open %s\n", path);
+		return 1;
+	}
+
+	LevelHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, levelMagic, sizeof(levelMagic));
+	h.version = levelVersion;
+	h.cannonMin = -3.4f; h.cannonMax = 4;
+	h.bucketStart[0] = -1; h.bucketStart[1] = 1;
+	h.bucketMin[0] = h.bucketMin[1] = -4;
+	h.bucketMax[0] = h.bucketMax[1] = 4;
+	h.spawnMin = -3; h.spawnMax = 4;
+	h.colourWeight[0] = h.colourWeight[1] = 1;
+	std::vector<LevelMirror> mirrors;
+	std::vector<LevelFall> falls;
+
+	char line[512];
+	while(fgets(line, sizeof(line), in)) {
+		lineNumber++;
+		line[strcspn(line, "#\r\n")] = 0;
+		char word[32], arg[32];
+		float a, b, c, d;
+		unsigned wr, wg, count;
+		if(sscanf(line, "%31s", word) != 1)
+			continue;
+		std::string w = word;
+		if(w == "cannon") {
+			if(sscanf(line, "%*s %f %f", &a, &b) != 2 || a >= b)
+				fail("cannon needs <min y> < <max y>");
+			h.cannonMin = a; h.cannonMax = b;
+		}
+		else if(w == "bucket") {
+			if(sscanf(line, "%*s %31s %f %f %f", arg, &a, &b, &c) != 4 || b > a || a > c)
+				fail("bucket needs red|green <start> <min> <max>, start within the rail");
+			int i = std::string(arg) == "red" ? 0 : std::string(arg) == "green" ? 1 : -1;
+			if(i < 0)
+				fail("bucket is red or green");
+			h.bucketStart[i] = a; h.bucketMin[i] = b; h.bucketMax[i] = c;
+		}
+		else if(w == "spawn") {
+			if(sscanf(line, "%*s %f %f %u %u", &a, &b, &wr, &wg) != 4 || a >= b || wr + wg == 0)
+				fail("spawn needs <min x> < <max x> and two weights, not both 0");
+			h.spawnMin = a; h.spawnMax = b;
+			h.colourWeight[0] = wr; h.colourWeight[1] = wg;
+		}
+		else if(w == "fall") {
+			if(sscanf(line, "%*s %f %f", &a, &b) != 2 || a < 0 || b < 0.01f || b > 0.05f)
+				fail("fall needs <seconds> and a rate in [0.01, 0.05]");
+			if(!falls.empty() && a <= falls.back().time)
+				fail("fall times have to increase");
+			LevelFall f = {a, b};
+			falls.push_back(f);
+		}
+		else if(w == "mirror") {
+			if(sscanf(line, "%*s %f %f %31s", &a, &b, arg) != 3)
+				fail("mirror needs <x> <y> <degrees | random>");
+			LevelMirror m = {a, b, randomAngle};
+			if(std::string(arg) != "random") {
+				m.angle = atof(arg);
+				if(m.angle != floorf(m.angle) || m.angle < 1 || m.angle > 89)
+					fail("mirror angles are whole degrees from 1 to 89");
+			}
+			mirrors.push_back(m);
+		}
+		else if(w == "scatter") {
+			unsigned seed;
+			if(sscanf(line, "%*s %u %f %f %f %f %u", &count, &a, &b, &c, &d, &seed) != 6 || a > b || c > d)
+				fail("scatter needs <count> <min x> <max x> <min y> <max y> <seed>");
+			uint32_t r = seed ? seed : 1;
+			for(unsigned i=0;i<count;i++) {
+				LevelMirror m;
+				r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+				m.x = a + (r >> 8)*(1.0f/16777216.0f)*(b - a);
+				r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+				m.y = c + (r >> 8)*(1.0f/16777216.0f)*(d - c);
+				r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+				m.angle = 1 + r % 89;
+				mirrors.push_back(m);
+			}
+		}
+		else
+			fail("unknown statement");
+	}
+	fclose(in);
+	if(falls.empty() || falls[0].time > 0) {
+		LevelFall f = {0, 0.03f};
+		falls.insert(falls.begin(), f);
+	}
+
+	int n = mirrors.size();
+	std::vector<uint32_t> cellStart, cellMirrors;
+	MirrorGrid grid;
+	buildMirrorGrid(mirrors.data(), n, cellStart, cellMirrors, grid);
+	int cols = grid.cols, rows = grid.rows;
+	h.gridCols = cols; h.gridRows = rows;
+	h.gridX = grid.x0; h.gridY = grid.y0;
+	h.cellW = grid.cellW; h.cellH = grid.cellH;
+
+	h.mirrorCount = n;
+	h.fallCount = falls.size();
+	h.cellEntries = cellMirrors.size();
+	h.size = levelSize(h.mirrorCount, h.fallCount, cols*rows, h.cellEntries);
+
+	std::vector<char> out;
+	auto append = [&](const void *p, size_t len) {
+		out.insert(out.end(), (const char*)p, (const char*)p + len);
+	};
+	append(&h, sizeof(h));
+	append(mirrors.data(), n*sizeof(LevelMirror));
+	append(falls.data(), falls.size()*sizeof(LevelFall));
+	append(cellStart.data(), cellStart.size()*sizeof(uint32_t));
+	append(cellMirrors.data(), cellMirrors.size()*sizeof(uint32_t));
+	if(out.size() != h.size || !levelValid((const LevelHeader*)out.data(), out.size()))
+		fail("internal error, the compiled level doesn't validate");
+
+	FILE *f = fopen(argv[2], "wb");
+	if(!f || fwrite(out.data(), 1, out.size(), f) != out.size()) {
+		fprintf(stderr, "can't write %s\n", argv[2]);
+		return 1;
+	}
+	fclose(f);
+	printf("%s: %d mirrors on a %dx%d grid (%u entries), %u fall steps, %u bytes\n",
+			argv[2], n, cols, rows, h.cellEntries, h.fallCount, h.size);
+	return 0;
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+// one instance per particle : position, age from 0 to 1 and palette entry
+layout (location = 0) in vec4 particle;
+
+uniform mat4 VP;
+uniform float size;       // half width of a fresh particle in world units
+uniform vec3 palette[3];
+
+out vec4 fragColor;
+
+void main ()
+{
+	// corners of a unit square, sized by the particle's age below
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1)*2.0 - 1.0;
+
+	// shrink and fade out, anything past its life collapses to nothing
+	float left = clamp(1.0 - particle.z, 0.0, 1.0);
+	vec2 position = particle.xy + corner*size*left;
+	fragColor = vec4(palette[int(particle.w)], left);
+
+	gl_Position = VP * vec4(position, 0, 1);
+}
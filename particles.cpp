@@ -0,0 +1,84 @@
+#include "particles.h"
+
+#include <math.h>
+
+const int particleGrain = 8192;       // particles per parallel-for chunk
+
+ParticleSystem::ParticleSystem(JobSystem &jobs, uint32_t seed)
+	: jobs(jobs), rng(seed ? seed : 1), head(0), tail(0),
+	x(maxParticles), y(maxParticles), vx(maxParticles), vy(maxParticles),
+	age(maxParticles), colour(maxParticles)
+{
+}
+
+/* xorshift32 in [0,1) */
+float ParticleSystem::random()
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return (rng >> 8)*(1.0f/16777216.0f);
+}
+
+void ParticleSystem::emit(float px, float py, int count, float speed, int c)
+{
+	if(count > maxParticles)
+		count = maxParticles;
+	for(int i=0;i<count;i++) {
+		int s = head++ & (maxParticles-1);
+		float angle = 2*(float)M_PI*random();
+		float v = speed*(0.3f + 0.7f*random());
+		x[s] = px; y[s] = py;
+		vx[s] = v*cosf(angle);
+		vy[s] = v*sinf(angle);
+		// a little spread in age so a burst doesn't vanish all at once
+		age[s] = 0.2f*particleLife*random();
+		colour[s] = c;
+	}
+	if(head - tail > (uint64_t)maxParticles)
+		tail = head - maxParticles;
+}
+
+/* Contiguous slots only, no branches, so the compiler can vectorise the state update */
+void ParticleSystem::updateSpan(int begin, int end, float dt, float *out)
+{
+	float *px = &x[0], *py = &y[0], *pvx = &vx[0], *pvy = &vy[0], *page = &age[0], *pc = &colour[0];
+	float fade = 1/particleLife;
+	for(int i=begin;i<end;i++) {
+		pvy[i] -= particleGravity*dt;
+		px[i] += pvx[i]*dt;
+		py[i] += pvy[i]*dt;
+		page[i] += dt;
+	}
+	for(int i=begin;i<end;i++) {
+		float *o = out + particleFloats*(i-begin);
+		o[0] = px[i];
+		o[1] = py[i];
+		o[2] = page[i]*fade;
+		o[3] = pc[i];
+	}
+}
+
+int ParticleSystem::update(float dt, float *instances)
+{
+	// emitted in order and only a little jitter in age, so the dead ones are (nearly) a prefix,
+	// the few that outlive their slot by a frame are hidden by the shader
+	while(tail < head && age[tail & (maxParticles-1)] + dt >= particleLife)
+		tail++;
+	int n = live();
+	if(n == 0)
+		return 0;
+	int first = tail & (maxParticles-1);
+	// the ring wraps at most once, the second span starts at slot 0
+	int firstSpan = n < maxParticles - first ? n : maxParticles - first;
+	jobs.parallelFor(n, particleGrain, [&](int begin, int end) {
+		if(begin < firstSpan) {
+			int stop = end < firstSpan ? end : firstSpan;
+			updateSpan(first + begin, first + stop, dt, instances + particleFloats*begin);
+			begin = stop;
+		}
+		if(begin < end)
+			updateSpan(begin - firstSpan, end - firstSpan, dt, instances + particleFloats*begin);
+	});
+	return n;
+}
@@ -0,0 +1,46 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "jobSystem.h"
+
+/* Sparks for shot and caught bricks.
+ * State is one array per field, kept in a ring. Every particle lives exactly
+ * particleLife seconds, so they die in the order they were emitted and the
+ * live ones are always [tail, head). When the ring is full a new burst takes
+ * over the oldest particles. Nothing is allocated after construction. */
+
+const int maxParticles = 1 << 17;
+const float particleLife = 0.8f;      // seconds
+const float particleGravity = 6.0f;   // world units per second squared
+
+/* What the instance buffer holds per particle : x, y, age in [0,1), colour */
+const int particleFloats = 4;
+
+class ParticleSystem {
+public:
+	explicit ParticleSystem(JobSystem &jobs, uint32_t seed = 1);
+
+	/* count sparks from (x,y) at speeds up to speed, colour picks the palette entry */
+	void emit(float x, float y, int count, float speed, int colour);
+
+	/* Advance every particle by dt seconds and write the live ones, oldest first,
+	 * to instances (particleFloats each). Returns how many were written. */
+	int update(float dt, float *instances);
+
+	int live() const { return (int)(head - tail); }
+
+private:
+	void updateSpan(int begin, int end, float dt, float *out);
+	float random();
+
+	JobSystem &jobs;
+	uint32_t rng;
+	uint64_t head, tail;   // ring positions, slot is position & (maxParticles-1)
+	std::vector<float> x, y, vx, vy, age;
+	std::vector<float> colour;
+};
+
+#endif
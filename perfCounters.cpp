@@ -0,0 +1,114 @@
+#include "perfCounters.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int openCounter(uint32_t type, uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.inherit = 1;               // threads started later count too
+	attr.exclude_kernel = 1;        // allowed up to perf_event_paranoid 2
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters()
+{
+	const uint64_t l1Miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	fds[perfCycles] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	fds[perfInstructions] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	fds[perfL1Misses] = openCounter(PERF_TYPE_HW_CACHE, l1Miss);
+	// the generic cache miss event is last level misses on the usual CPUs
+	fds[perfLLCMisses] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	fds[perfBranchMisses] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	if(!available())
+		printf("perf: no hardware counters (perf_event_open failed, see /proc/sys/kernel/perf_event_paranoid), timing only\n");
+}
+
+PerfCounters::~PerfCounters()
+{
+	for(int i=0;i<perfCounterCount;i++)
+		if(fds[i] >= 0)
+			close(fds[i]);
+}
+
+bool PerfCounters::available() const
+{
+	for(int i=0;i<perfCounterCount;i++)
+		if(fds[i] >= 0)
+			return true;
+	return false;
+}
+
+void PerfCounters::start()
+{
+	for(int i=0;i<perfCounterCount;i++)
+		if(fds[i] >= 0) {
+			ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+}
+
+PerfSample PerfCounters::stop()
+{
+	PerfSample s;
+	for(int i=0;i<perfCounterCount;i++) {
+		s.value[i] = -1;
+		if(fds[i] < 0)
+			continue;
+		ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		uint64_t data[3];         // value, time enabled, time running
+		if(read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+			continue;
+		s.value[i] = (double)data[0]*data[1]/data[2];
+	}
+	return s;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+	for(int i=0;i<perfCounterCount;i++)
+		fds[i] = -1;
+	printf("perf: hardware counters need Linux, timing only\n");
+}
+
+PerfCounters::~PerfCounters() {}
+bool PerfCounters::available() const { return false; }
+void PerfCounters::start() {}
+
+PerfSample PerfCounters::stop()
+{
+	PerfSample s;
+	for(int i=0;i<perfCounterCount;i++)
+		s.value[i] = -1;
+	return s;
+}
+
+#endif
+
+void PerfCounters::print(const char *name, const PerfSample &s, double seconds, double items, const char *itemName)
+{
+	static const char *names[perfCounterCount] = {"cycles", "instructions", "L1D misses", "LLC misses", "branch misses"};
+	printf("%-6s %.3f s, %.1f ns/%s", name, seconds, 1e9*seconds/items, itemName);
+	for(int i=0;i<perfCounterCount;i++)
+		if(s.value[i] >= 0)
+			printf(", %.2f %s", s.value[i]/items, names[i]);
+	if(s.value[perfCycles] > 0 && s.value[perfInstructions] >= 0)
+		printf(", IPC %.2f", s.value[perfInstructions]/s.value[perfCycles]);
+	printf("\n");
+}
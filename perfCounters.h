@@ -0,0 +1,34 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/* Hardware counters for the benchmarks, through Linux perf_event_open.
+ * Each counter is opened on its own, so a machine or VM that lacks one (LLC misses
+ * often) still gets the rest. Counting covers the opening thread and any thread it
+ * starts afterwards, so open them before making the thread pool to count its workers.
+ * Anywhere counters can't be opened (other systems, perf_event_paranoid, containers)
+ * available() is false and reports only show time. */
+
+enum PerfCounter { perfCycles, perfInstructions, perfL1Misses, perfLLCMisses, perfBranchMisses, perfCounterCount };
+
+struct PerfSample {
+	double value[perfCounterCount];    // -1 where the counter couldn't be opened
+};
+
+class PerfCounters {
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	bool available() const;
+	/* Zero every counter and start counting */
+	void start();
+	/* Stop and read, scaled up if the kernel had to multiplex the counters */
+	PerfSample stop();
+	/* One line per benchmark: time, the counters per item and IPC */
+	static void print(const char *name, const PerfSample &s, double seconds, double items, const char *itemName);
+
+private:
+	int fds[perfCounterCount];
+};
+
+#endif
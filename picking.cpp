@@ -0,0 +1,81 @@
+#include "picking.h"
+
+#include <algorithm>
+
+/* Squared distance from (x,y) to mirror i's segment */
+static float mirrorDistance2(const PickScene &s, int i, float x, float y)
+{
+	int a = angleIndex(s.mirrorAng[i]);
+	float dx = mirrorLength*cosIndex(a), dy = mirrorLength*sinIndex(a);
+	float px = x - s.mirrorx[i], py = y - s.mirrory[i];
+	float t = std::min(std::max((px*dx + py*dy)/(dx*dx + dy*dy), 0.0f), 1.0f);
+	px -= t*dx; py -= t*dy;
+	return px*px + py*py;
+}
+
+static int pickMirrorAt(const PickScene &s, float x, float y)
+{
+	int best = -1;
+	float bestDistance = pickRadius*pickRadius;
+	auto consider = [&](int i) {
+		float d = mirrorDistance2(s, i, x, y);
+		if(d <= bestDistance) {
+			best = i;
+			bestDistance = d;
+		}
+	};
+	if(!s.grid) {
+		for(int i=0;i<s.numMirrors;i++)
+			consider(i);
+		return best;
+	}
+	// every cell the pick radius reaches, a cell lists each mirror that crosses it
+	const MirrorGrid &g = *s.grid;
+	int cx0 = std::max((int)floorf((x - pickRadius - g.x0)/g.cellW), 0);
+	int cx1 = std::min((int)floorf((x + pickRadius - g.x0)/g.cellW), g.cols - 1);
+	int cy0 = std::max((int)floorf((y - pickRadius - g.y0)/g.cellH), 0);
+	int cy1 = std::min((int)floorf((y + pickRadius - g.y0)/g.cellH), g.rows - 1);
+	for(int cy=cy0;cy<=cy1;cy++)
+		for(int cx=cx0;cx<=cx1;cx++) {
+			int cell = cy*g.cols + cx;
+			for(uint32_t k=g.cellStart[cell];k<g.cellStart[cell+1];k++)
+				consider(g.cellMirrors[k]);
+		}
+	if(g.loose >= 0)
+		consider(g.loose);
+	return best;
+}
+
+static int pickBrickAt(const PickScene &s, float x, float y)
+{
+	// bases are sorted, only the bricks within a brick's size of y can be under the point
+	float base = (float)(y + s.brickFallen);
+	const float *low = std::lower_bound(s.brickBase + s.brickBegin, s.brickBase + s.brickEnd, base - 0.1f);
+	for(int i=(int)(low - s.brickBase);i<s.brickEnd && s.brickBase[i] <= base + 0.1f;i++)
+		if(s.brickColour[i] >= 0 && std::abs(s.brickx[i] - x) <= 0.1f)
+			return i;
+	return -1;
+}
+
+Pick pickAt(const PickScene &s, float x, float y)
+{
+	Pick p = {pickNothing, -1};
+	if(y < -3.6f) {
+		for(int b=0;b<2;b++)
+			if(inBucket(x, s.bucketShift[b])) {
+				p.kind = pickBucket; p.index = b;
+				return p;
+			}
+	}
+	if(x < -3.4f && std::abs(y - s.cannonShift) <= 0.5f) {
+		p.kind = pickCannon;
+		return p;
+	}
+	if((p.index = pickBrickAt(s, x, y)) >= 0) {
+		p.kind = pickBrick;
+		return p;
+	}
+	if((p.index = pickMirrorAt(s, x, y)) >= 0)
+		p.kind = pickMirror;
+	return p;
+}
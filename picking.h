@@ -0,0 +1,37 @@
+#ifndef PICKING_H
+#define PICKING_H
+
+#include "gameLogic.h"
+
+/* What is under the mouse. Points are in world coordinates, the caller unprojects the
+ * cursor through the inverse view-projection first, so zoom and pan are accounted for.
+ * Buckets and the cannon are checked directly. Mirrors are looked up in the cells of
+ * the level's mirror grid around the point, bricks by binary search on their base height,
+ * which is sorted since bricks are kept in landing order, so a pick costs the same
+ * with three mirrors and a few bricks as with tens of thousands. */
+
+enum PickKind { pickNothing, pickBucket, pickCannon, pickBrick, pickMirror };
+
+struct Pick {
+	PickKind kind;
+	int index;          // bucket 0 red 1 green, brick or mirror index
+};
+
+struct PickScene {
+	float bucketShift[2];
+	float cannonShift;
+	const float *brickx, *brickBase; // [brickBegin, brickEnd), lowest first
+	double brickFallen;              // a brick is at brickBase[i] - brickFallen
+	const int *brickColour;
+	int brickBegin, brickEnd;
+	const float *mirrorx, *mirrory, *mirrorAng;
+	int numMirrors;
+	const MirrorGrid *grid;          // NULL tests every mirror
+};
+
+const float pickRadius = 0.1f;      // how far from a mirror's segment still grabs it
+
+/* Frontmost object at (x,y): buckets and cannon, then bricks, then mirrors */
+Pick pickAt(const PickScene &scene, float x, float y);
+
+#endif
@@ -0,0 +1,61 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool snapshotValid(const GameSnapshot *s, size_t len)
+{
+	if(len < sizeof(GameSnapshot) || memcmp(s->magic, snapshotMagic, sizeof(snapshotMagic)) != 0)
+		return false;
+	return s->version == snapshotVersion && s->size == len && s->size == snapshotSize(s->brickCount, s->mirrorCount);
+}
+
+bool writeSnapshot(const char *path, const GameSnapshot *s)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		fprintf(stderr, "snapshot: can't create %s\n", path);
+		return false;
+	}
+	ssize_t done = write(fd, s, s->size);
+	close(fd);
+	if(done != (ssize_t)s->size) {
+		fprintf(stderr, "snapshot: short write to %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+const GameSnapshot *mapSnapshot(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "snapshot: can't open %s\n", path);
+		return NULL;
+	}
+	struct stat st;
+	void *p = MAP_FAILED;
+	if(fstat(fd, &st) == 0 && st.st_size > 0)
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) {
+		fprintf(stderr, "snapshot: can't map %s\n", path);
+		return NULL;
+	}
+	const GameSnapshot *s = (const GameSnapshot*)p;
+	if(!snapshotValid(s, st.st_size)) {
+		fprintf(stderr, "snapshot: %s is not a version %u snapshot\n", path, snapshotVersion);
+		munmap(p, st.st_size);
+		return NULL;
+	}
+	return s;
+}
+
+void unmapSnapshot(const GameSnapshot *s)
+{
+	munmap((void*)s, s->size);
+}
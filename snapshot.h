@@ -0,0 +1,63 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gameLogic.h"
+
+/* Save states. A snapshot is a GameSnapshot followed by the live bricks as three
+ * arrays (x, y, colour) of brickCount entries each, then the mirrors as three
+ * arrays (x, y, angle) of mirrorCount entries. The layout is fixed and
+ * native-endian, so a snapshot is written with a single write() and used
+ * straight from an mmap of the file, or from memory for fast save/restore. */
+
+const char snapshotMagic[8] = {'B','R','I','C','K','S','N','P'};
+/* bump whenever GameSnapshot changes */
+const uint32_t snapshotVersion = 2;
+
+struct GameSnapshot {
+	char magic[8];
+	uint32_t version;
+	uint32_t brickCount;
+	uint64_t size;               // bytes, bricks and mirrors included
+	uint32_t mirrorCount;
+	uint32_t nextFall;           // next step of the level's fall rate schedule
+
+	double simTime, newRecTime;
+	double shotAge;              // seconds since the last shot, the clock isn't saved
+	float cannonShift, cannonAngle;
+	float BucShift[2];
+	float fallRate, lastDrop;
+	int32_t score, collected[2], blackhits, wronghits;
+	int32_t countRectangles;
+	uint32_t rng;                // spawn random number generator
+};
+
+static_assert(sizeof(GameSnapshot) % 8 == 0, "brick arrays must start aligned");
+
+inline size_t snapshotSize(int bricks, int mirrors)
+{
+	return sizeof(GameSnapshot) + (size_t)bricks*(2*sizeof(float) + sizeof(int32_t)) + (size_t)mirrors*3*sizeof(float);
+}
+
+inline float *snapshotBrickx(GameSnapshot *s) { return (float*)(s + 1); }
+inline float *snapshotBricky(GameSnapshot *s) { return snapshotBrickx(s) + s->brickCount; }
+inline int32_t *snapshotColour(GameSnapshot *s) { return (int32_t*)(snapshotBricky(s) + s->brickCount); }
+inline const float *snapshotBrickx(const GameSnapshot *s) { return (const float*)(s + 1); }
+inline const float *snapshotBricky(const GameSnapshot *s) { return snapshotBrickx(s) + s->brickCount; }
+inline const int32_t *snapshotColour(const GameSnapshot *s) { return (const int32_t*)(snapshotBricky(s) + s->brickCount); }
+/* x, y and angle of every mirror, one after the other */
+inline float *snapshotMirrors(GameSnapshot *s) { return (float*)(snapshotColour(s) + s->brickCount); }
+inline const float *snapshotMirrors(const GameSnapshot *s) { return (const float*)(snapshotColour(s) + s->brickCount); }
+
+/* Magic, version and sizes agree with the len bytes at s */
+bool snapshotValid(const GameSnapshot *s, size_t len);
+
+/* Write size bytes in one go, false with a message on stderr on failure */
+bool writeSnapshot(const char *path, const GameSnapshot *s);
+/* Map a snapshot file read-only, NULL with a message if it is missing or doesn't match this build */
+const GameSnapshot *mapSnapshot(const char *path);
+void unmapSnapshot(const GameSnapshot *s);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+
+/* Fixed set of worker threads that split a loop over [0,n) into chunks.
+ * The calling thread works on chunks too, so a pool of size 1 runs inline. */
+class ThreadPool {
+public:
+	explicit ThreadPool(int numThreads = 0)
+	{
+		if(numThreads <= 0)
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+		for(int i=1;i<numThreads;i++)
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(size_t i=0;i<workers.size();i++)
+			workers[i].join();
+	}
+
+	int size() const { return (int)workers.size() + 1; }
+
+	/* Call fn(begin,end) for chunks of grain items, returns once every chunk is done.
+	 * Like JobSystem::parallelFor it wraps fn by reference. */
+	template <class F>
+	void parallelFor(int n, int grain, const F &fn)
+	{
+		parallelForRef(n, grain, std::function<void(int,int)>(std::cref(fn)));
+	}
+
+private:
+	void parallelForRef(int n, int grain, const std::function<void(int,int)> &fn)
+	{
+		if(n <= 0)
+			return;
+		grain = std::max(grain, 1);
+		int chunks = (n + grain - 1)/grain;
+		if(workers.empty() || chunks == 1) {
+			fn(0, n);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			job = &fn; jobSize = n; jobGrain = grain; jobChunks = chunks;
+			nextChunk.store(0);
+			chunksLeft.store(chunks);
+			generation++;
+		}
+		wake.notify_all();
+		runChunks();
+		std::unique_lock<std::mutex> guard(lock);
+		// wait for stragglers too, they still hold a pointer to fn
+		finished.wait(guard, [this] { return chunksLeft.load() == 0 && active == 0; });
+		job = NULL;
+	}
+
+	void runChunks()
+	{
+		int c;
+		while((c = nextChunk.fetch_add(1)) < jobChunks) {
+			int begin = c*jobGrain;
+			(*job)(begin, std::min(jobSize, begin + jobGrain));
+			if(chunksLeft.fetch_sub(1) == 1) {
+				std::lock_guard<std::mutex> guard(lock);
+				finished.notify_all();
+			}
+		}
+	}
+
+	void workerLoop()
+	{
+		TRACE_THREAD("pool worker");
+		unsigned seen = 0;
+		std::unique_lock<std::mutex> guard(lock);
+		while(true) {
+			wake.wait(guard, [&] { return stopping || generation != seen; });
+			if(stopping)
+				return;
+			seen = generation;
+			active++;
+			guard.unlock();
+			runChunks();
+			guard.lock();
+			active--;
+			if(active == 0)
+				finished.notify_all();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake, finished;
+	const std::function<void(int,int)> *job = NULL;
+	int jobSize = 0, jobGrain = 1, jobChunks = 0;
+	std::atomic<int> nextChunk{0}, chunksLeft{0};
+	unsigned generation = 0;
+	int active = 0;
+	bool stopping = false;
+};
+
+#endif
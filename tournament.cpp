@@ -0,0 +1,190 @@
+#include "tournament.h"
+
+#include <math.h>
+#include <stdio.h>
+
+const int solveEvery = 15;            // steps between two solves of a seat
+const int seatBudgets = 5;            // seats try 128, 256, ... 2048 shots per solve, then repeat
+const int scoreDigits = 6;            // a game's score is drawn in the top left of its cell, clamped to this
+/* seven segment digits, bit 0 is the top segment, then clockwise, bit 6 is the middle one */
+const unsigned char digitSegments[10] = { 0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f };
+
+Tournament::Tournament(int games, uint32_t seed)
+	: serial(1), envs(games, 1, seed, 1), seats(games), actions(games), ticks(0)
+{
+	for(int g=0;g<games;g++) {
+		Seat &s = seats[g];
+		s.aim = new AutoAim(serial);
+		s.target.value = 0;
+		s.candidates = 128 << (g % seatBudgets);
+		// solves are staggered so they don't all land on the same step
+		s.ticksLeft = g % solveEvery;
+		s.rng = seed*2654435761u + (uint32_t)g*40503u + 1;
+		s.running = 0; s.episodes = 0; s.total = 0; s.best = 0;
+	}
+	envs.reset_all();
+}
+
+Tournament::~Tournament()
+{
+	for(size_t g=0;g<seats.size();g++)
+		delete seats[g].aim;
+}
+
+int Tournament::columns() const
+{
+	return (int)ceil(sqrt((double)size()));
+}
+
+/* Takes the snapshot of a seat whose solve is due, tick() runs the solves together */
+int Tournament::plan(int game)
+{
+	Seat &s = seats[game];
+	if(s.ticksLeft-- > 0)
+		return 0;
+	EnvView v = envs.view(game);
+	AimSnapshot &snap = s.snap;
+	snap.cannonShift = v.cannonShift; snap.cannonAngle = v.cannonAngle;
+	snap.cannonMin = envCannonMin; snap.cannonMax = envCannonMax;
+	snap.charge = v.charge; snap.fallRate = v.fallRate;
+	snap.mirrorx = v.mirrorx; snap.mirrory = v.mirrory; snap.mirrorAng = v.mirrorAng;
+	snap.numMirrors = numMirrors; snap.grid = NULL;
+	snap.numBricks = v.numBricks < aimMaxBricks ? v.numBricks : aimMaxBricks;
+	for(int i=0;i<snap.numBricks;i++) {
+		snap.brickx[i] = v.brickx[i]; snap.bricky[i] = v.bricky[i]; snap.brickColour[i] = v.brickColour[i];
+	}
+	s.rng ^= s.rng << 13; s.rng ^= s.rng >> 17; s.rng ^= s.rng << 5;
+	s.ticksLeft = solveEvery;
+	return 1;
+}
+
+/* Same steering as the single game's bot, on this seat's game */
+void Tournament::control(int game, EnvAction &action)
+{
+	Seat &s = seats[game];
+	EnvView v = envs.view(game);
+	float dshift = s.target.cannonShift - v.cannonShift;
+	float dangle = s.target.cannonAngle - v.cannonAngle;
+	action.cannonShift = std::abs(dshift) < cannonSpeed*stepScale ? 0 : (dshift > 0 ? 1 : -1);
+	action.cannonRot = std::abs(dangle) < cannonTurn*stepScale ? 0 : (dangle > 0 ? 1 : -1);
+	action.red = 0; action.green = 0;
+	action.shoot = s.target.value > 0 && action.cannonShift == 0 && action.cannonRot == 0 && v.charge >= 1;
+	if(action.shoot)
+		s.ticksLeft = 0;
+}
+
+void Tournament::tick()
+{
+	solving.clear();
+	for(int g=0;g<size();g++)
+		if(plan(g))
+			solving.push_back(g);
+	// a seat per chunk, each solve runs on one thread so seats don't fight over the pool
+	pool.parallelFor((int)solving.size(), 1, [this](int begin, int end) {
+		for(int i=begin;i<end;i++) {
+			Seat &s = seats[solving[i]];
+			s.target = s.aim->solve(s.snap, s.candidates, s.rng);
+		}
+	});
+	for(int g=0;g<size();g++)
+		control(g, actions[g]);
+	EnvStepResult res = envs.step_batch(&actions[0]);
+	for(int g=0;g<size();g++) {
+		Seat &s = seats[g];
+		s.running += (int)res.rewards[g];
+		if(res.dones[g]) {
+			s.episodes++;
+			s.total += s.running;
+			if(s.running > s.best)
+				s.best = s.running;
+			s.running = 0;
+		}
+	}
+	ticks++;
+}
+
+int Tournament::maxShapes() const
+{
+	// cell, two buckets, mirrors, cannon, bricks, the beam, and the score's sign and segments
+	return size()*(4 + numMirrors + envMaxBricks + maxLaserSegments + 1 + 7*scoreDigits);
+}
+
+static float *shape(float *out, float x, float y, float halfW, float halfH, float c, float s, int palette, int game)
+{
+	out[0] = x; out[1] = y; out[2] = halfW; out[3] = halfH;
+	out[4] = c; out[5] = s;
+	out[6] = palette; out[7] = game;
+	return out + shapeFloats;
+}
+
+/* The game's own score as seven segment digits, right aligned in the top left corner of its cell */
+static float *scoreShapes(float *out, int score, int game)
+{
+	const float w = 0.12f, h = 0.2f, t = 0.03f, step = 0.35f;
+	float x = -3.6f + (scoreDigits - 1)*step, y = 3.5f;
+	int left = score < 0 ? -score : score, digits = 0;
+	int most = 1;
+	for(int i=0;i<scoreDigits;i++)
+		most *= 10;
+	if(left >= most)
+		left = most - 1;
+	do {
+		int bits = digitSegments[left % 10];
+		if(bits & 0x01) out = shape(out, x, y + h, w, t, 1, 0, paletteBlack, game);
+		if(bits & 0x02) out = shape(out, x + w, y + h/2, t, h/2, 1, 0, paletteBlack, game);
+		if(bits & 0x04) out = shape(out, x + w, y - h/2, t, h/2, 1, 0, paletteBlack, game);
+		if(bits & 0x08) out = shape(out, x, y - h, w, t, 1, 0, paletteBlack, game);
+		if(bits & 0x10) out = shape(out, x - w, y - h/2, t, h/2, 1, 0, paletteBlack, game);
+		if(bits & 0x20) out = shape(out, x - w, y + h/2, t, h/2, 1, 0, paletteBlack, game);
+		if(bits & 0x40) out = shape(out, x, y, w, t, 1, 0, paletteBlack, game);
+		left /= 10;
+		x -= step;
+		digits++;
+	} while(left > 0 && digits < scoreDigits);
+	if(score < 0)
+		out = shape(out, x, y, w, t, 1, 0, paletteBlack, game);
+	return out;
+}
+
+int Tournament::shapes(float *out) const
+{
+	float *start = out;
+	for(int g=0;g<size();g++) {
+		EnvView v = envs.view(g);
+		// drawn in order, later shapes cover earlier ones
+		out = shape(out, 0, 0, 4, 4, 1, 0, paletteCell, g);
+		out = shape(out, v.redShift, -3.75f, 0.5f, 0.25f, 1, 0, paletteRed, g);
+		out = shape(out, v.greenShift, -3.75f, 0.5f, 0.25f, 1, 0, paletteGreen, g);
+		for(int i=0;i<numMirrors;i++) {
+			int a = angleIndex(v.mirrorAng[i]);
+			float half = mirrorLength/2;
+			out = shape(out, v.mirrorx[i] + half*cosIndex(a), v.mirrory[i] + half*sinIndex(a), half, 0.03f, cosIndex(a), sinIndex(a), paletteMirror, g);
+		}
+		int a = angleIndex(v.cannonAngle);
+		out = shape(out, -4 + 0.25f*cosIndex(a), v.cannonShift + 0.25f*sinIndex(a), 0.25f, 0.15f, cosIndex(a), sinIndex(a), paletteBlack, g);
+		for(int i=0;i<v.numBricks;i++) {
+			int colour = v.brickColour[i];
+			out = shape(out, v.brickx[i], v.bricky[i], 0.1f, 0.1f, 1, 0, colour > 1 ? paletteBlack : colour, g);
+		}
+		for(int i=0;i<v.laserSegments;i++) {
+			const float *seg = v.laser + 4*i;
+			float dx = seg[2] - seg[0], dy = seg[3] - seg[1];
+			float length = sqrtf(dx*dx + dy*dy);
+			if(length > 0)
+				out = shape(out, (seg[0] + seg[2])/2, (seg[1] + seg[3])/2, length/2, 0.02f, dx/length, dy/length, paletteLaser, g);
+		}
+		out = scoreShapes(out, v.score, g);
+	}
+	return (int)(out - start)/shapeFloats;
+}
+
+void Tournament::report() const
+{
+	printf("tournament: %d games, %ld steps (%.1f s of play each)\n", size(), ticks, ticks*simStep);
+	printf("tournament: seat  shots/solve  episodes  mean score  best  current\n");
+	for(int g=0;g<size();g++) {
+		const Seat &s = seats[g];
+		printf("tournament: %4d  %11d  %8ld  %10.1f  %4d  %7d\n", g, s.candidates, s.episodes,
+				s.episodes ? (double)s.total/s.episodes : 0.0, s.best, s.running);
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "autoAim.h"
+#include "brickEnv.h"
+#include "threadPool.h"
+
+/* Many bot games in one process, --tournament.
+ * The games are the environments of a BrickEnvBatch and every seat has its own
+ * AutoAim bot, seats differ in how many shots they try per solve. The game's own
+ * state is global, so a tournament game is the env's version of the rules and is
+ * drawn as a sketch of the real scene, not by draw(). Drawing is one instanced
+ * pass over shapes(): each shape is a rotated quad tagged with its game, the
+ * vertex shader places it in that game's cell of the grid. Every game's bricks,
+ * beam and score, as seven segment digits, are its own shapes. */
+
+const int shapeFloats = 8;    // x, y, half width, half height, cos, sin, palette entry, game
+enum ShapePalette { paletteRed, paletteGreen, paletteBlack, paletteCell, paletteMirror, paletteLaser };
+
+class Tournament {
+public:
+	Tournament(int games, uint32_t seed);
+	~Tournament();
+
+	/* One simStep of every game */
+	void tick();
+	/* Fills out with every game's shapes, at most maxShapes(), and returns how many */
+	int shapes(float *out) const;
+	int maxShapes() const;
+	int size() const { return envs.size(); }
+	/* Grid columns, rows follow from the game count */
+	int columns() const;
+	void report() const;
+
+private:
+	struct Seat {
+		AutoAim *aim;
+		AimSnapshot snap;      // taken by plan() for this tick's solve
+		AimResult target;
+		int candidates;
+		int ticksLeft;         // until the next solve
+		uint32_t rng;
+		int running;           // score of the episode being played
+		long episodes, total;
+		int best;
+	};
+
+	int plan(int game);
+	void control(int game, EnvAction &action);
+
+	ThreadPool pool;       // spreads the seats' solves
+	ThreadPool serial;     // size 1, each solve runs inline on its seat's thread
+	BrickEnvBatch envs;
+	std::vector<Seat> seats;
+	std::vector<EnvAction> actions;
+	std::vector<int> solving;   // seats solving this tick
+	long ticks;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#version 330 core
+
+// one instance per shape : centre and half size, then cos, sin, palette entry and game
+layout (location = 0) in vec4 placement;
+layout (location = 1) in vec4 rotation;
+
+uniform int columns;       // games per row of the grid
+uniform vec3 palette[6];
+
+out vec4 fragColor;
+
+void main ()
+{
+	// corner in the shape's own frame, then turned by its cos and sin into world units
+	vec2 corner = (vec2(gl_VertexID & 1, gl_VertexID >> 1)*2.0 - 1.0)*placement.zw;
+	vec2 world = placement.xy + vec2(corner.x*rotation.x - corner.y*rotation.y, corner.x*rotation.y + corner.y*rotation.x);
+
+	// the game's cell, filled left to right and top to bottom, the world [-4,4] takes 95% of it
+	int game = int(rotation.w);
+	float cell = 2.0/float(columns);
+	vec2 centre = vec2(-1.0 + (float(game % columns) + 0.5)*cell, 1.0 - (float(game / columns) + 0.5)*cell);
+	fragColor = vec4(palette[int(rotation.z)], 1);
+
+	gl_Position = vec4(centre + world*(0.95*cell/8.0), 0, 1);
+}
@@ -0,0 +1,67 @@
+#include "trace.h"
+
+#include <stdio.h>
+
+#ifdef TRACE_ZONES
+
+static const char *tracePath = NULL;
+static int64_t traceOrigin = 0;
+
+bool traceEnabled() { return true; }
+
+void traceStart(const char *path)
+{
+	tracePath = path;
+	traceOrigin = traceNow();
+	TRACE_THREAD("main");
+	traceState().recording.store(true);
+}
+
+bool traceWrite()
+{
+	TraceState &s = traceState();
+	if(!tracePath)
+		return false;
+	s.recording.store(false);
+	FILE *f = fopen(tracePath, "w");
+	if(!f) {
+		fprintf(stderr, "trace: can't write %s\n", tracePath);
+		return false;
+	}
+	// complete events ("X") with microsecond times, plus a name for every thread
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	long zones = 0, dropped = 0;
+	const char *comma = "";
+	std::lock_guard<std::mutex> guard(s.lock);
+	for(size_t i=0;i<s.buffers.size();i++) {
+		TraceBuffer *b = s.buffers[i];
+		if(b->threadName) {
+			fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+					comma, b->tid, b->threadName);
+			comma = ",\n";
+		}
+		int n = b->count.load(std::memory_order_acquire);
+		for(int j=0;j<n;j++) {
+			const TraceZone &z = b->zones[j];
+			fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					comma, z.name, b->tid, (z.begin - traceOrigin)/1000.0, (z.end - z.begin)/1000.0);
+			comma = ",\n";
+		}
+		zones += n;
+		dropped += b->dropped;
+	}
+	fprintf(f, "\n]}\n");
+	bool ok = fclose(f) == 0;
+	printf("trace: %ld zones from %d threads written to %s\n", zones, (int)s.buffers.size(), tracePath);
+	if(dropped > 0)
+		printf("trace: %ld zones dropped, buffers hold %d per thread\n", dropped, traceCapacity);
+	return ok;
+}
+
+#else
+
+bool traceEnabled() { return false; }
+void traceStart(const char *) {}
+bool traceWrite() { return false; }
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Scoped timeline zones, written out as Chrome trace JSON (chrome://tracing or
+ * ui.perfetto.dev open it). TRACE_ZONE("name") times the rest of the enclosing block.
+ * Zones only exist in builds made with make TRACE=1, which defines TRACE_ZONES;
+ * make TRACE=2 adds TRACE_FINE zones in inner loops such as find_mirror, which
+ * the bot calls thousands of times a frame. Otherwise every macro is empty.
+ *
+ * Each thread appends to its own buffer, no locks once the buffer exists. A full
+ * buffer drops further zones and says how many at the end. Names are kept by
+ * pointer, so they have to be string literals or otherwise live for the whole run. */
+
+#ifdef TRACE_ZONES
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+const int traceCapacity = 1 << 20;      // zones per thread, 24 MB
+
+struct TraceZone {
+	const char *name;
+	int64_t begin, end;                  // ns
+};
+
+struct TraceBuffer {
+	int tid;
+	const char *threadName;
+	std::atomic<int> count;
+	long dropped;
+	TraceZone zones[traceCapacity];
+};
+
+struct TraceState {
+	std::atomic<bool> recording;
+	std::mutex lock;                     // only taken when a thread makes its buffer
+	std::vector<TraceBuffer*> buffers;
+};
+
+inline TraceState &traceState()
+{
+	static TraceState state;
+	return state;
+}
+
+inline int64_t traceNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline TraceBuffer *traceBuffer()
+{
+	static thread_local TraceBuffer *buffer = NULL;
+	if(!buffer) {
+		TraceState &s = traceState();
+		buffer = new TraceBuffer;
+		buffer->threadName = NULL;
+		buffer->count.store(0);
+		buffer->dropped = 0;
+		std::lock_guard<std::mutex> guard(s.lock);
+		buffer->tid = (int)s.buffers.size() + 1;
+		s.buffers.push_back(buffer);
+	}
+	return buffer;
+}
+
+class TraceScope {
+public:
+	explicit TraceScope(const char *name)
+		: name(traceState().recording.load(std::memory_order_relaxed) ? name : NULL),
+		begin(this->name ? traceNow() : 0)
+	{
+	}
+	~TraceScope()
+	{
+		if(!name)
+			return;
+		TraceBuffer *b = traceBuffer();
+		int n = b->count.load(std::memory_order_relaxed);
+		if(n == traceCapacity) {
+			b->dropped++;
+			return;
+		}
+		TraceZone &z = b->zones[n];
+		z.name = name; z.begin = begin; z.end = traceNow();
+		// the writer reads count first, so the zone has to be filled before it grows
+		b->count.store(n + 1, std::memory_order_release);
+	}
+private:
+	const char *name;
+	int64_t begin;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_ZONE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD(name) (traceBuffer()->threadName = (name))
+#ifdef TRACE_FINE
+#define TRACE_ZONE_FINE(name) TRACE_ZONE(name)
+#else
+#define TRACE_ZONE_FINE(name)
+#endif
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_ZONE_FINE(name)
+#define TRACE_THREAD(name)
+
+#endif
+
+bool traceEnabled();
+/* Start keeping zones, they are written to path by traceWrite */
+void traceStart(const char *path);
+/* Write every thread's zones so far as Chrome trace JSON, false if the file can't be written */
+bool traceWrite();
+
+#endif
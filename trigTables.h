@@ -0,0 +1,94 @@
+#ifndef TRIG_TABLES_H
+#define TRIG_TABLES_H
+
+#include <math.h>
+
+/* Sine, cosine and tangent of every angle the game can produce, built at compile time.
+ * The cannon turns in steps of 1/angleSteps degree (cannonTurn*stepScale) and mirrors
+ * sit at whole degrees, reflections (2*mirror - angle) stay on the same grid, so one
+ * table over a full turn covers the laser, the mirrors and the cannon drawing. */
+
+const int angleSteps = 20;                  // table entries per degree
+const int angleTurn = 360*angleSteps;       // entries in a full turn
+
+struct TrigTables {
+	float sine[angleTurn];
+	float cosine[angleTurn];
+	float tangent[angleTurn];
+};
+
+/* Taylor series around 0, |x| <= pi needs about 30 terms for long double precision */
+constexpr long double seriesSin(long double x)
+{
+	long double term = x, sum = x;
+	for(int n=1;n<40;n++) {
+		term *= -x*x/((2*n)*(2*n+1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr long double seriesCos(long double x)
+{
+	long double term = 1, sum = 1;
+	for(int n=1;n<40;n++) {
+		term *= -x*x/((2*n-1)*(2*n));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr TrigTables makeTrigTables()
+{
+	TrigTables t = {};
+	for(int i=0;i<angleTurn;i++) {
+		// signed angle in (-180, 180], converted to radians the way angle*M_PI/180.0f used to,
+		// so tan at 90 degrees is the same large finite value tanf gave, not infinity
+		int step = i > angleTurn/2 ? i - angleTurn : i;
+		float degrees = step/(float)angleSteps;
+		float radians = degrees*M_PI/180.0f;
+		long double s = seriesSin(radians), c = seriesCos(radians);
+		t.sine[i] = (float)s;
+		t.cosine[i] = (float)c;
+		t.tangent[i] = (float)(s/c);
+	}
+	return t;
+}
+
+constexpr TrigTables trigTables = makeTrigTables();
+
+/* Nearest table entry of an angle in degrees, any angle works */
+inline int angleIndex(float degrees)
+{
+	int i = (int)lroundf(degrees*angleSteps) % angleTurn;
+	return i < 0 ? i + angleTurn : i;
+}
+
+/* Round an angle in degrees to the grid the tables cover */
+inline float snapAngle(float degrees)
+{
+	return lroundf(degrees*angleSteps)/(float)angleSteps;
+}
+
+inline float sinIndex(int i) { return trigTables.sine[i]; }
+inline float cosIndex(int i) { return trigTables.cosine[i]; }
+inline float tanIndex(int i) { return trigTables.tangent[i]; }
+
+/* Reflection of the beam at index beam off a mirror at index mirror, on the same grid */
+inline int reflectIndex(int mirror, int beam)
+{
+	int i = (2*mirror - beam) % angleTurn;
+	return i < 0 ? i + angleTurn : i;
+}
+
+// exact values the series has to hit, and the table indexing
+constexpr float trigError(float a, float b) { return a > b ? a - b : b - a; }
+static_assert(trigTables.sine[0] == 0 && trigTables.cosine[0] == 1, "sin/cos of 0");
+static_assert(trigError(trigTables.sine[30*angleSteps], 0.5f) < 1e-6f, "sin 30");
+static_assert(trigError(trigTables.cosine[60*angleSteps], 0.5f) < 1e-6f, "cos 60");
+static_assert(trigError(trigTables.tangent[45*angleSteps], 1.0f) < 1e-6f, "tan 45");
+static_assert(trigError(trigTables.sine[270*angleSteps], -1.0f) < 1e-6f, "sin -90");
+static_assert(trigError(trigTables.tangent[135*angleSteps], -1.0f) < 1e-6f, "tan 135");
+static_assert(trigTables.tangent[90*angleSteps] < -1e7f, "tan 90 stays finite, as tanf had it");
+
+#endif
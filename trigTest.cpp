@@ -0,0 +1,48 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "gameLogic.h"
+
+/* make trigtest: every entry of the trig tables against libm at the same angle, and a
+ * shot through the classic mirrors traced by the probe object that nm found no trig in */
+
+const float sinCosTolerance = 1e-6f;        // absolute
+const float tanTolerance = 1e-5f;           // relative, tan runs up to 1e7 near 90 degrees
+
+int probeLaser(float cannonShift, float cannonAngle, const float *mirrorx, const float *mirrory, const float *mirrorAng,
+		int nmirrors, const MirrorGrid *grid, float *segments);
+
+int main()
+{
+	int failures = 0;
+	float worstSin = 0, worstCos = 0, worstTan = 0;
+	for(int i=0;i<angleTurn;i++) {
+		// the same angle the tables were built for, signed in (-180, 180]
+		int step = i > angleTurn/2 ? i - angleTurn : i;
+		float radians = step/(float)angleSteps*M_PI/180.0f;
+		float s = fabsf(sinIndex(i) - sinf(radians));
+		float c = fabsf(cosIndex(i) - cosf(radians));
+		float t = fabsf(tanIndex(i) - tanf(radians))/fmaxf(fabsf(tanf(radians)), 1);
+		worstSin = fmaxf(worstSin, s); worstCos = fmaxf(worstCos, c); worstTan = fmaxf(worstTan, t);
+		if(s > sinCosTolerance || c > sinCosTolerance || t > tanTolerance) {
+			if(failures++ < 10)
+				printf("trigtest: entry %d (%.2f degrees) sin %g cos %g tan %g, libm %g %g %g\n", i, step/(float)angleSteps,
+						sinIndex(i), cosIndex(i), tanIndex(i), sinf(radians), cosf(radians), tanf(radians));
+		}
+	}
+	printf("trigtest: %d entries, worst sin %.2g cos %.2g tan %.2g (relative)\n", angleTurn, worstSin, worstCos, worstTan);
+
+	// the probe has to trace something for its missing trig calls to mean anything
+	float mirrorAng[numMirrors] = {30, 45, 60}, segments[4*maxLaserSegments];
+	int n = probeLaser(0, 10, mirrorStartX, mirrorStartY, mirrorAng, numMirrors, NULL, segments);
+	if(n < 1) {
+		printf("trigtest: the laser probe traced no segments\n");
+		failures++;
+	}
+	if(failures) {
+		printf("trigtest: %d failures\n", failures);
+		return 1;
+	}
+	printf("trigtest: passed\n");
+	return 0;
+}
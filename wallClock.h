@@ -0,0 +1,12 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <chrono>
+
+/* Seconds on the steady clock, for measuring and pacing. Only differences mean anything */
+inline double wallClock()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif